@@ -10,6 +10,8 @@
  * thread_id for each VCPU thread from the QMP server. Based on that
  * information, the client program can then pin the corresponding VCPUs to
  * dedicated PCPUs and isolate interrupts and tasks from those PCPUs.
+ * run_tests.sh --pin <cpulist> (or PIN_CPUS=<cpulist> for the arm-run
+ * script) does the QMP and pinning part automatically.
  *
  * Copyright Columbia University
  * Author: Shih-Wei Li <shihwei@cs.columbia.edu>
@@ -19,12 +21,9 @@
  * This work is licensed under the terms of the GNU LGPL, version 2.
  */
 #include <libcflat.h>
+#include <bench.h>
 #include <asm/gic.h>
 
-#define NTIMES (1U << 16)
-
-static u32 cntfrq;
-
 static volatile bool ipi_ready, ipi_received;
 static void *vgic_dist_base;
 static void (*write_eoir)(u32 irqstat);
@@ -76,9 +75,6 @@ static bool test_init(void)
 	gic_enable_defaults();
 	on_cpu_async(1, ipi_secondary_entry, NULL);
 
-	cntfrq = get_cntfrq();
-	printf("Timer Frequency %d Hz (Output in microseconds)\n", cntfrq);
-
 	return true;
 }
 
@@ -153,44 +149,23 @@ static struct exit_test tests[] = {
 	{"ipi",			ipi_prep,	ipi_exec,		true},
 };
 
-struct ns_time {
-	uint64_t ns;
-	uint64_t ns_frac;
-};
-
-#define PS_PER_SEC (1000 * 1000 * 1000 * 1000UL)
-static void ticks_to_ns_time(uint64_t ticks, struct ns_time *ns_time)
+static void exec_batch(void *data, u64 iters)
 {
-	uint64_t ps_per_tick = PS_PER_SEC / cntfrq + !!(PS_PER_SEC % cntfrq);
-	uint64_t ps;
+	struct exit_test *test = data;
 
-	ps = ticks * ps_per_tick;
-	ns_time->ns = ps / 1000;
-	ns_time->ns_frac = (ps % 1000) / 100;
+	while (iters--)
+		test->exec();
 }
 
 static void loop_test(struct exit_test *test)
 {
-	uint64_t start, end, total_ticks, ntimes = NTIMES;
-	struct ns_time total_ns, avg_ns;
+	static struct bench bench;
 
 	if (test->prep)
 		test->prep();
 
-	isb();
-	start = read_sysreg(cntpct_el0);
-	while (ntimes--)
-		test->exec();
-	isb();
-	end = read_sysreg(cntpct_el0);
-
-	total_ticks = end - start;
-	ticks_to_ns_time(total_ticks, &total_ns);
-	avg_ns.ns = total_ns.ns / NTIMES;
-	avg_ns.ns_frac = total_ns.ns_frac / NTIMES;
-
-	printf("%-30s%15" PRId64 ".%-15" PRId64 "%15" PRId64 ".%-15" PRId64 "\n",
-		test->name, total_ns.ns, total_ns.ns_frac, avg_ns.ns, avg_ns.ns_frac);
+	bench_run(&bench, exec_batch, test);
+	bench_report(test->name, &bench);
 }
 
 int main(int argc, char **argv)
@@ -200,10 +175,6 @@ int main(int argc, char **argv)
 	if (!test_init())
 		return 1;
 
-	printf("\n%-30s%18s%13s%18s%13s\n", "name", "total ns", "", "avg ns", "");
-	for (i = 0 ; i < 92; ++i)
-		printf("%c", '-');
-	printf("\n");
 	for (i = 0; i < ARRAY_SIZE(tests); i++) {
 		if (!tests[i].run)
 			continue;
@@ -226,7 +226,7 @@ static int rtc_fdt_init(void)
 	u32 *data;
 	int ret;
 
-	node = fdt_node_offset_by_compatible(fdt, -1, "arm,pl031");
+	node = dt_node_offset_by_compatible(-1, "arm,pl031");
 	if (node < 0)
 		return -1;
 
@@ -314,7 +314,7 @@ static bool psci_check(void)
 	const struct fdt_property *method;
 	int node, len, ver;
 
-	node = fdt_node_offset_by_compatible(dt_fdt(), -1, "arm,psci-0.2");
+	node = dt_node_offset_by_compatible(-1, "arm,psci-0.2");
 	if (node < 0) {
 		printf("PSCI v0.2 compatibility required\n");
 		return false;
@@ -11,76 +11,61 @@
  */
 
 #include <libcflat.h>
+#include <spinlock-test.h>
+#include <asm/setup.h>
 #include <asm/smp.h>
-#include <asm/barrier.h>
 
 #define LOOP_SIZE 10000000
 
-struct lock_ops {
-	void (*lock)(int *v);
-	void (*unlock)(int *v);
-};
-static struct lock_ops lock_ops;
-
-static void gcc_builtin_lock(int *lock_var)
+static void gcc_builtin_lock(struct spinlock *lock)
 {
-	while (__sync_lock_test_and_set(lock_var, 1));
+	while (__sync_lock_test_and_set(&lock->v, 1));
 }
-static void gcc_builtin_unlock(int *lock_var)
+static void gcc_builtin_unlock(struct spinlock *lock)
 {
-	__sync_lock_release(lock_var);
+	__sync_lock_release(&lock->v);
 }
-static void none_lock(int *lock_var)
+static void none_lock(struct spinlock *lock)
 {
-	while (*(volatile int *)lock_var != 0);
-	*(volatile int *)lock_var = 1;
+	while (*(volatile unsigned int *)&lock->v != 0);
+	*(volatile unsigned int *)&lock->v = 1;
 }
-static void none_unlock(int *lock_var)
+static void none_unlock(struct spinlock *lock)
 {
-	*(volatile int *)lock_var = 0;
+	*(volatile unsigned int *)&lock->v = 0;
 }
 
-static int global_a, global_b;
-static int global_lock;
+static struct lock_ops lock_ops_list[] = {
+	{ "tas",	tas_spin_lock,		tas_spin_unlock },
+	{ "ticket",	ticket_spin_lock,	ticket_spin_unlock },
+	{ "mcs",	mcs_spin_lock,		mcs_spin_unlock },
+	{ "spin_lock",	spin_lock,		spin_unlock },
+	{ "gcc",	gcc_builtin_lock,	gcc_builtin_unlock },
+	{ "bad",	none_lock,		none_unlock },
+};
 
-static void test_spinlock(void *data __unused)
+static struct lock_ops *find_lock_ops(const char *name)
 {
-	int i, errors = 0;
-	int cpu = smp_processor_id();
-
-	printf("CPU%d online\n", cpu);
-
-	for (i = 0; i < LOOP_SIZE; i++) {
+	int i;
 
-		lock_ops.lock(&global_lock);
+	for (i = 0; i < ARRAY_SIZE(lock_ops_list); i++)
+		if (!strcmp(name, lock_ops_list[i].name))
+			return &lock_ops_list[i];
 
-		if (global_a == (cpu + 1) % 2) {
-			global_a = 1;
-			global_b = 0;
-		} else {
-			global_a = 0;
-			global_b = 1;
-		}
-
-		if (global_a == global_b)
-			errors++;
-
-		lock_ops.unlock(&global_lock);
-	}
-	report("CPU%d: Done - Errors: %d", errors == 0, cpu, errors);
+	/* anything else means the gcc builtins, as it used to */
+	return find_lock_ops("gcc");
 }
 
 int main(int argc, char **argv)
 {
-	if (argc > 1 && strcmp(argv[1], "bad") != 0) {
-		lock_ops.lock = gcc_builtin_lock;
-		lock_ops.unlock = gcc_builtin_unlock;
+	if (argc > 1) {
+		run_spinlock_test(find_lock_ops(argv[1]), nr_cpus, LOOP_SIZE);
 	} else {
-		lock_ops.lock = none_lock;
-		lock_ops.unlock = none_unlock;
+		/* compare the flavours of spin_lock() */
+		run_spinlock_test(find_lock_ops("tas"), nr_cpus, LOOP_SIZE);
+		run_spinlock_test(find_lock_ops("ticket"), nr_cpus, LOOP_SIZE);
+		run_spinlock_test(find_lock_ops("mcs"), nr_cpus, LOOP_SIZE);
 	}
 
-	on_cpus(test_spinlock, NULL);
-
 	return report_summary();
 }
@@ -0,0 +1 @@
+../x86/string-ops.c
\ No newline at end of file
@@ -277,7 +277,7 @@ static void test_init(void)
 	int node, len;
 	u32 *data;
 
-	node = fdt_node_offset_by_compatible(fdt, -1, "arm,armv8-timer");
+	node = dt_node_offset_by_compatible(-1, "arm,armv8-timer");
 	assert(node >= 0);
 	prop = fdt_get_property(fdt, node, "interrupts", &len);
 	assert(prop && len == (4 * 3 * sizeof(u32)));
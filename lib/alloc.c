@@ -1,5 +1,6 @@
 #include "alloc.h"
 #include "asm/page.h"
+#include "asm/spinlock.h"
 
 void *malloc(size_t size)
 {
@@ -29,6 +30,111 @@ static inline uintptr_t block_size(void *mem)
 	return *(uintptr_t *)(mem + OFS_SIZE);
 }
 
+/*
+ * When alloc_ops hands out whole pages, e.g. vmalloc_ops, small blocks
+ * are carved from pages ("slabs") of same-sized objects instead, with
+ * one size class per power of two.  The block size in the metadata of a
+ * slab object is odd, which tells free() where the block came from.
+ * Objects are aligned to their size, so the metadata keeps the pointer
+ * returned to the caller aligned to METADATA_EXTRA.
+ */
+#define SLAB_MIN_SHIFT	5
+#define SLAB_MAX_SHIFT	(PAGE_SHIFT - 2)
+#define SLAB_CLASSES	(SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+#define SLAB_OBJECT	1
+
+struct slab {
+	struct slab *next;
+	struct slab *prev;
+	void *free;		/* list of freed objects */
+	void *unused;		/* objects past this were never handed out */
+	unsigned int shift;
+	unsigned int inuse;
+};
+
+static struct spinlock slab_lock;
+/* slabs with free objects, per size class */
+static struct slab *partial[SLAB_CLASSES];
+
+static void slab_list_add(struct slab *slab)
+{
+	struct slab **head = &partial[slab->shift - SLAB_MIN_SHIFT];
+
+	slab->prev = NULL;
+	slab->next = *head;
+	if (slab->next)
+		slab->next->prev = slab;
+	*head = slab;
+}
+
+static void slab_list_del(struct slab *slab)
+{
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		partial[slab->shift - SLAB_MIN_SHIFT] = slab->next;
+	if (slab->next)
+		slab->next->prev = slab->prev;
+}
+
+static void *slab_alloc(unsigned int shift)
+{
+	struct slab *slab;
+	void *obj;
+
+	spin_lock(&slab_lock);
+	slab = partial[shift - SLAB_MIN_SHIFT];
+	if (!slab) {
+		spin_unlock(&slab_lock);
+		slab = alloc_ops->memalign(PAGE_SIZE, PAGE_SIZE);
+		assert(slab);
+		slab->shift = shift;
+		slab->inuse = 0;
+		slab->free = NULL;
+		slab->unused = (void *)slab +
+			       ALIGN(sizeof(struct slab), 1ul << shift);
+		spin_lock(&slab_lock);
+		slab_list_add(slab);
+	}
+
+	if (slab->free) {
+		obj = slab->free;
+		slab->free = *(void **)obj;
+	} else {
+		obj = slab->unused;
+		slab->unused += 1ul << shift;
+	}
+	slab->inuse++;
+	if (!slab->free && slab->unused == (void *)slab + PAGE_SIZE)
+		slab_list_del(slab);
+	spin_unlock(&slab_lock);
+
+	return obj;
+}
+
+static void slab_free(void *obj)
+{
+	struct slab *slab = (void *)((uintptr_t)obj & PAGE_MASK);
+	bool was_full;
+
+	spin_lock(&slab_lock);
+	was_full = !slab->free && slab->unused == (void *)slab + PAGE_SIZE;
+	*(void **)obj = slab->free;
+	slab->free = obj;
+	slab->inuse--;
+
+	if (was_full)
+		slab_list_add(slab);
+	/* give the page back, unless it is the last one of its class */
+	if (!slab->inuse && (slab->prev || slab->next)) {
+		slab_list_del(slab);
+		spin_unlock(&slab_lock);
+		alloc_ops->free(slab, PAGE_SIZE);
+		return;
+	}
+	spin_unlock(&slab_lock);
+}
+
 void free(void *ptr)
 {
 	if (!alloc_ops->free)
@@ -37,7 +143,10 @@ void free(void *ptr)
 	void *base = block_begin(ptr);
 	uintptr_t sz = block_size(ptr);
 
-	alloc_ops->free(base, sz);
+	if (sz & SLAB_OBJECT)
+		slab_free(base);
+	else
+		alloc_ops->free(base, sz);
 }
 
 void *memalign(size_t alignment, size_t size)
@@ -45,6 +154,7 @@ void *memalign(size_t alignment, size_t size)
 	void *p;
 	uintptr_t blkalign;
 	uintptr_t mem;
+	unsigned int shift;
 
 	if (!size)
 		return NULL;
@@ -52,6 +162,23 @@ void *memalign(size_t alignment, size_t size)
 	assert(alignment >= sizeof(void *) && is_power_of_2(alignment));
 	assert(alloc_ops && alloc_ops->memalign);
 
+	if (alloc_ops->align_min == PAGE_SIZE) {
+		uintptr_t need = size + METADATA_EXTRA;
+
+		if (alignment > METADATA_EXTRA)
+			need += alignment - 1;
+		for (shift = SLAB_MIN_SHIFT; shift <= SLAB_MAX_SHIFT; shift++) {
+			if (need > (1ul << shift))
+				continue;
+			p = slab_alloc(shift);
+			memset(p, 0, 1ul << shift);
+			mem = ALIGN((uintptr_t)p + METADATA_EXTRA, alignment);
+			*(uintptr_t *)(mem + OFS_SLACK) = mem - (uintptr_t)p;
+			*(uintptr_t *)(mem + OFS_SIZE) = (1ul << shift) | SLAB_OBJECT;
+			return (void *)mem;
+		}
+	}
+
 	size += alignment - 1;
 	blkalign = MAX(alignment, alloc_ops->align_min);
 	size = ALIGN(size + METADATA_EXTRA, alloc_ops->align_min);
@@ -1,8 +1,33 @@
 /*
  * This work is licensed under the terms of the GNU LGPL, version 2.
  *
- * This is a simple allocator that provides contiguous physical addresses
+ * This is a buddy allocator that provides contiguous physical addresses
  * with page granularity.
+ *
+ * Free memory is kept as naturally aligned blocks of (1 << order) pages,
+ * in one list per order.  The header of a free block lives in its first
+ * page.  Each memory area, i.e. each range given to free_pages() that is
+ * not part of a known area, has a bitmap carved from its first pages,
+ * with one bit per page that is set when a free block starts there.
+ * That is enough to find out in O(1) whether the buddy of a block is
+ * free, so both allocating and freeing a block take O(log n).
+ *
+ * Areas are handed to the buddy lists lazily: the pages from an area's
+ * lazy pfn up to its top have never been touched, and blocks are only
+ * carved from there, along with their part of the bitmap, when the
+ * lists run dry.  Setting up the allocator therefore doesn't touch
+ * memory at all, however much RAM the guest has.
+ *
+ * alloc_page() and free_page() go through a small cache of pages per
+ * CPU, which is refilled from and drained to the buddy lists in
+ * batches, so that CPUs allocating single pages at the same time don't
+ * all serialize on the allocator lock.  Each cache has a lock of its
+ * own, which only its CPU takes, but for allocations that would fail
+ * otherwise: those drain all the caches before giving up.  A cache's
+ * lock is always taken before the allocator lock.
+ *
+ * Interrupts are disabled while any of the locks is held, so that
+ * interrupt handlers may allocate and free pages too.
  */
 #include "libcflat.h"
 #include "alloc.h"
@@ -12,19 +37,303 @@
 #include <asm/page.h>
 #include <asm/io.h>
 #include <asm/spinlock.h>
+#include <asm/smp.h>
+#include <asm/irqflags.h>
+
+#define NR_ORDERS	(BITS_PER_LONG - PAGE_SHIFT)
+#define MAX_AREAS	4
+/* the part of the bitmap covering a block of this order fills a page */
+#define CARVE_ORDER	(PAGE_SHIFT + 3)
+
+struct free_block {
+	struct free_block *next;
+	struct free_block *prev;
+	unsigned long order;
+};
+
+struct mem_area {
+	unsigned long base;	/* first pfn */
+	unsigned long top;	/* last pfn + 1 */
+	unsigned long lazy;	/* first pfn not given to the buddy lists */
+	unsigned long *free_heads;
+};
 
 static struct spinlock lock;
-static void *freelist = 0;
+static struct mem_area areas[MAX_AREAS];
+static unsigned int nr_areas;
+static struct free_block *free_lists[NR_ORDERS];
+
+#define PAGE_CACHE_CPUS		256
+#define PAGE_CACHE_SIZE		32
+#define PAGE_CACHE_BATCH	16
+
+struct page_cache {
+	struct spinlock lock;
+	unsigned int nr;
+	void *pages[PAGE_CACHE_SIZE];
+} __attribute__((aligned(64)));
+
+static struct page_cache page_caches[PAGE_CACHE_CPUS];
+
+static inline unsigned long page_pfn(void *mem)
+{
+	return virt_to_phys(mem) >> PAGE_SHIFT;
+}
+
+static inline void *pfn_page(unsigned long pfn)
+{
+	return phys_to_virt((phys_addr_t)pfn << PAGE_SHIFT);
+}
+
+static struct mem_area *find_area(unsigned long pfn)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_areas; i++)
+		if (pfn >= areas[i].base && pfn < areas[i].top)
+			return &areas[i];
+	return NULL;
+}
+
+static bool is_free_head(struct mem_area *a, unsigned long pfn)
+{
+	unsigned long bit = pfn - a->base;
+
+	return a->free_heads[BIT_WORD(bit)] & BIT_MASK(bit);
+}
+
+static void add_block(struct mem_area *a, unsigned long pfn,
+		      unsigned long order)
+{
+	struct free_block *b = pfn_page(pfn);
+	unsigned long bit = pfn - a->base;
+
+	b->order = order;
+	b->prev = NULL;
+	b->next = free_lists[order];
+	if (b->next)
+		b->next->prev = b;
+	free_lists[order] = b;
+	a->free_heads[BIT_WORD(bit)] |= BIT_MASK(bit);
+}
+
+static void del_block(struct mem_area *a, struct free_block *b)
+{
+	unsigned long bit = page_pfn(b) - a->base;
+
+	if (b->prev)
+		b->prev->next = b->next;
+	else
+		free_lists[b->order] = b->next;
+	if (b->next)
+		b->next->prev = b->prev;
+	a->free_heads[BIT_WORD(bit)] &= ~BIT_MASK(bit);
+}
+
+/* Free one block, merging it with its buddies as far as possible. */
+static void free_block(struct mem_area *a, unsigned long pfn,
+		       unsigned long order)
+{
+	struct free_block *buddy;
+	unsigned long buddy_pfn;
+
+	assert_msg(!is_free_head(a, pfn), "double free of %p", pfn_page(pfn));
+
+	while (order < NR_ORDERS - 1) {
+		buddy_pfn = pfn ^ BIT(order);
+		if (buddy_pfn < a->base || buddy_pfn + BIT(order) > a->lazy ||
+		    !is_free_head(a, buddy_pfn))
+			break;
+		buddy = pfn_page(buddy_pfn);
+		if (buddy->order != order)
+			break;
+		del_block(a, buddy);
+		pfn &= ~BIT(order);
+		order++;
+	}
+	add_block(a, pfn, order);
+}
+
+/* The order of the largest naturally aligned block at pfn below top. */
+static unsigned long block_order(unsigned long pfn, unsigned long top,
+				 unsigned long max_order)
+{
+	unsigned long order = 0;
+
+	while (order < max_order && !(pfn & BIT(order)) &&
+	       pfn + BIT(order + 1) <= top)
+		order++;
+	return order;
+}
+
+/* Free [pfn, top) as the largest naturally aligned blocks that fit. */
+static void free_range(struct mem_area *a, unsigned long pfn,
+		       unsigned long top)
+{
+	unsigned long order;
+
+	while (pfn < top) {
+		order = block_order(pfn, top, NR_ORDERS - 1);
+		free_block(a, pfn, order);
+		pfn += BIT(order);
+	}
+}
+
+/* The bitmap is only valid below a->lazy, clear it for [pfn, top). */
+static void clear_free_heads(struct mem_area *a, unsigned long pfn,
+			     unsigned long top)
+{
+	unsigned long bit = pfn - a->base, end = top - a->base;
+
+	for (; bit < end && bit % BITS_PER_LONG; bit++)
+		a->free_heads[BIT_WORD(bit)] &= ~BIT_MASK(bit);
+	for (; bit + BITS_PER_LONG <= end; bit += BITS_PER_LONG)
+		a->free_heads[BIT_WORD(bit)] = 0;
+	for (; bit < end; bit++)
+		a->free_heads[BIT_WORD(bit)] &= ~BIT_MASK(bit);
+}
+
+/*
+ * Move untouched memory to the buddy lists until they hold a block of
+ * at least the given order.  Blocks are carved no larger than needed,
+ * or than CARVE_ORDER, so that each step touches about two pages.
+ */
+static bool carve(unsigned long order)
+{
+	unsigned long pfn, o;
+	struct mem_area *a;
+
+	for (a = areas; a < areas + nr_areas; a++) {
+		while (a->lazy < a->top) {
+			pfn = a->lazy;
+			o = block_order(pfn, a->top, MAX(order, CARVE_ORDER));
+			clear_free_heads(a, pfn, pfn + BIT(o));
+			a->lazy += BIT(o);
+			free_block(a, pfn, o);
+			if (o >= order)
+				return true;
+		}
+	}
+	return false;
+}
+
+static void add_area(unsigned long base, unsigned long top)
+{
+	unsigned long meta = ALIGN((top - base + BITS_PER_BYTE - 1) /
+				   BITS_PER_BYTE, PAGE_SIZE) >> PAGE_SHIFT;
+	struct mem_area *a;
+
+	assert_msg(nr_areas < MAX_AREAS, "too many memory areas");
+	assert_msg(top - base > meta, "memory area too small: %p-%p",
+		   pfn_page(base), pfn_page(top));
+
+	a = &areas[nr_areas++];
+	a->base = base;
+	a->top = top;
+	a->lazy = base + meta;
+	a->free_heads = pfn_page(base);
+	/* the bitmap's own pages are buddies of the first blocks carved */
+	clear_free_heads(a, base, a->lazy);
+}
+
+static void __free_pages(void *mem, unsigned long size)
+{
+	unsigned long pfn = page_pfn(mem);
+	unsigned long top = pfn + (size >> PAGE_SHIFT);
+	struct mem_area *a = find_area(pfn);
+
+	if (a) {
+		assert_msg(top <= a->lazy, "%p + %#lx was never allocated",
+			   mem, size);
+		free_range(a, pfn, top);
+	} else {
+		assert_msg(!find_area(top - 1),
+			   "%p + %#lx overlaps a memory area", mem, size);
+		add_area(pfn, top);
+	}
+}
+
+static void *__alloc_pages(unsigned long order)
+{
+	struct free_block *b;
+	struct mem_area *a;
+	unsigned long i, pfn;
+
+	for (;;) {
+		for (i = order; i < NR_ORDERS && !free_lists[i]; i++)
+			;
+		if (i < NR_ORDERS)
+			break;
+		if (order >= NR_ORDERS || !carve(order))
+			return NULL;
+	}
+
+	b = free_lists[i];
+	pfn = page_pfn(b);
+	a = find_area(pfn);
+	del_block(a, b);
+	/* give back the upper halves until the block has the right size */
+	while (i > order) {
+		i--;
+		add_block(a, pfn + BIT(i), i);
+	}
+	return b;
+}
+
+static struct page_cache *this_page_cache(void)
+{
+	unsigned int cpu = smp_processor_id();
+
+	return cpu < PAGE_CACHE_CPUS ? &page_caches[cpu] : NULL;
+}
+
+/* Give the pages in all the CPUs' caches back to the buddy lists */
+static void drain_page_caches(void)
+{
+	struct page_cache *c;
+
+	for (c = page_caches; c < page_caches + PAGE_CACHE_CPUS; c++) {
+		if (!*(volatile unsigned int *)&c->nr)
+			continue;
+		spin_lock(&c->lock);
+		spin_lock(&lock);
+		while (c->nr)
+			__free_pages(c->pages[--c->nr], PAGE_SIZE);
+		spin_unlock(&lock);
+		spin_unlock(&c->lock);
+	}
+}
+
+/*
+ * Allocate from the buddy lists, and if they can't satisfy the request,
+ * drain the caches and try again.  Called with interrupts disabled and
+ * without any lock held.
+ */
+static void *take_pages(unsigned long order)
+{
+	void *p;
+
+	spin_lock(&lock);
+	p = __alloc_pages(order);
+	spin_unlock(&lock);
+	if (p)
+		return p;
+
+	drain_page_caches();
+	spin_lock(&lock);
+	p = __alloc_pages(order);
+	spin_unlock(&lock);
+	return p;
+}
 
 bool page_alloc_initialized(void)
 {
-	return freelist != 0;
+	return nr_areas != 0;
 }
 
 void free_pages(void *mem, unsigned long size)
 {
-	void *old_freelist;
-	void *end;
+	unsigned long flags;
 
 	assert_msg((unsigned long) mem % PAGE_SIZE == 0,
 		   "mem not page aligned: %p", mem);
@@ -35,22 +344,18 @@ void free_pages(void *mem, unsigned long size)
 		   (uintptr_t)mem + size > (uintptr_t)mem,
 		   "mem + size overflow: %p + %#lx", mem, size);
 
-	if (size == 0) {
-		freelist = NULL;
-		return;
-	}
-
+	flags = local_irq_save();
 	spin_lock(&lock);
-	old_freelist = freelist;
-	freelist = mem;
-	end = mem + size;
-	while (mem + PAGE_SIZE != end) {
-		*(void **)mem = (mem + PAGE_SIZE);
-		mem += PAGE_SIZE;
+	if (size == 0) {
+		/* forget about all memory */
+		nr_areas = 0;
+		memset(free_lists, 0, sizeof(free_lists));
+		memset(page_caches, 0, sizeof(page_caches));
+	} else {
+		__free_pages(mem, size);
 	}
-
-	*(void **)mem = old_freelist;
 	spin_unlock(&lock);
+	local_irq_restore(flags);
 }
 
 void free_pages_by_order(void *mem, unsigned long order)
@@ -58,111 +363,108 @@ void free_pages_by_order(void *mem, unsigned long order)
 	free_pages(mem, 1ul << (order + PAGE_SHIFT));
 }
 
-void *alloc_page()
+/*
+ * Allocates (1 << order) physically contiguous and naturally aligned pages.
+ * Returns NULL if there's no memory left.
+ */
+void *alloc_pages(unsigned long order)
 {
+	unsigned long flags;
 	void *p;
 
-	if (!freelist)
-		return 0;
+	assert(order < sizeof(unsigned long) * 8);
 
-	spin_lock(&lock);
-	p = freelist;
-	freelist = *(void **)freelist;
-	spin_unlock(&lock);
+	flags = local_irq_save();
+	p = take_pages(order);
+	local_irq_restore(flags);
 
 	if (p)
-		memset(p, 0, PAGE_SIZE);
+		memset(p, 0, PAGE_SIZE << order);
 	return p;
 }
 
-/*
- * Allocates (1 << order) physically contiguous and naturally aligned pages.
- * Returns NULL if there's no memory left.
- */
-void *alloc_pages(unsigned long order)
+void *alloc_page()
 {
-	/* Generic list traversal. */
-	void *prev;
-	void *curr = NULL;
-	void *next = freelist;
+	struct page_cache *c;
+	unsigned long flags;
+	void *p;
 
-	/* Looking for a run of length (1 << order). */
-	unsigned long run = 0;
-	const unsigned long n = 1ul << order;
-	const unsigned long align_mask = (n << PAGE_SHIFT) - 1;
-	void *run_start = NULL;
-	void *run_prev = NULL;
-	unsigned long run_next_pa = 0;
-	unsigned long pa;
+	flags = local_irq_save();
+	c = this_page_cache();
+	if (!c) {
+		p = take_pages(0);
+		goto out;
+	}
 
-	assert(order < sizeof(unsigned long) * 8);
+	spin_lock(&c->lock);
+	if (!c->nr) {
+		spin_lock(&lock);
+		while (c->nr < PAGE_CACHE_BATCH && (p = __alloc_pages(0)))
+			c->pages[c->nr++] = p;
+		spin_unlock(&lock);
+	}
+	p = c->nr ? c->pages[--c->nr] : NULL;
+	spin_unlock(&c->lock);
 
-	spin_lock(&lock);
-	for (;;) {
-		prev = curr;
-		curr = next;
+	/* the other CPUs' caches may still have some */
+	if (!p)
+		p = take_pages(0);
+out:
+	local_irq_restore(flags);
 
-		if (!curr) {
-			run_start = NULL;
-			break;
-		}
+	if (p)
+		memset(p, 0, PAGE_SIZE);
+	return p;
+}
 
-		next = *((void **) curr);
-		pa = virt_to_phys(curr);
-
-		if (run == 0) {
-			if (!(pa & align_mask)) {
-				run_start = curr;
-				run_prev = prev;
-				run_next_pa = pa + PAGE_SIZE;
-				run = 1;
-			}
-		} else if (pa == run_next_pa) {
-			run_next_pa += PAGE_SIZE;
-			run += 1;
-		} else {
-			run = 0;
-		}
+void free_page(void *page)
+{
+	struct page_cache *c;
+	unsigned long flags;
 
-		if (run == n) {
-			if (run_prev)
-				*((void **) run_prev) = next;
-			else
-				freelist = next;
-			break;
-		}
+	assert_msg((unsigned long) page % PAGE_SIZE == 0,
+		   "page not page aligned: %p", page);
+
+	flags = local_irq_save();
+	c = this_page_cache();
+	if (!c) {
+		spin_lock(&lock);
+		__free_pages(page, PAGE_SIZE);
+		spin_unlock(&lock);
+		goto out;
 	}
-	spin_unlock(&lock);
-	if (run_start)
-		memset(run_start, 0, n * PAGE_SIZE);
-	return run_start;
-}
 
+	spin_lock(&c->lock);
+	if (c->nr == PAGE_CACHE_SIZE) {
+		spin_lock(&lock);
+		while (c->nr > PAGE_CACHE_SIZE - PAGE_CACHE_BATCH)
+			__free_pages(c->pages[--c->nr], PAGE_SIZE);
+		spin_unlock(&lock);
+	}
+	c->pages[c->nr++] = page;
+	spin_unlock(&c->lock);
+out:
+	local_irq_restore(flags);
+}
 
-void free_page(void *page)
+static unsigned long size_to_order(size_t size)
 {
-	spin_lock(&lock);
-	*(void **)page = freelist;
-	freelist = page;
-	spin_unlock(&lock);
+	unsigned long n = ALIGN(size, PAGE_SIZE) >> PAGE_SHIFT;
+
+	return is_power_of_2(n) ? fls(n) : fls(n) + 1;
 }
 
 static void *page_memalign(size_t alignment, size_t size)
 {
-	unsigned long n = ALIGN(size, PAGE_SIZE) >> PAGE_SHIFT;
-	unsigned long order;
-
 	if (!size)
 		return NULL;
 
-	order = is_power_of_2(n) ? fls(n) : fls(n) + 1;
-
-	return alloc_pages(order);
+	return alloc_pages(size_to_order(size));
 }
 
 static void page_free(void *mem, size_t size)
 {
-	free_pages(mem, size);
+	free_pages_by_order(mem, size_to_order(size));
 }
 
 static struct alloc_ops page_alloc_ops = {
@@ -0,0 +1,21 @@
+#ifndef _ASMARM_BENCH_H_
+#define _ASMARM_BENCH_H_
+
+#ifndef _BENCH_H_
+#error Do not directly include <asm/bench.h>. Just use <bench.h>.
+#endif
+
+#include <asm/processor.h>
+
+/* The virtual counter, which get_cntvct() reads after an ISB */
+static inline u64 bench_cycles(void)
+{
+	return get_cntvct();
+}
+
+static inline u64 bench_cycles_hz(void)
+{
+	return get_cntfrq();
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _ASMARM_IRQFLAGS_H_
+#define _ASMARM_IRQFLAGS_H_
+/*
+ * local_irq_save() masks IRQs on the calling CPU and returns the
+ * previous state, which local_irq_restore() puts back.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+
+static inline unsigned long local_irq_save(void)
+{
+	unsigned long flags;
+
+	asm volatile(
+	"	mrs	%0, cpsr\n"
+	"	cpsid	i\n"
+	: "=r" (flags) : : "memory", "cc");
+	return flags;
+}
+
+static inline void local_irq_restore(unsigned long flags)
+{
+	asm volatile("msr cpsr_c, %0" : : "r" (flags) : "memory", "cc");
+}
+
+#endif /* _ASMARM_IRQFLAGS_H_ */
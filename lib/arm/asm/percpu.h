@@ -0,0 +1,13 @@
+#ifndef _ASMARM_PERCPU_H_
+#define _ASMARM_PERCPU_H_
+
+#ifndef _PERCPU_H_
+#error Do not directly include <asm/percpu.h>. Just use <percpu.h>.
+#endif
+
+#include <asm/thread_info.h>
+
+/* thread_info_init() sets it from the CPU's id */
+#define __my_cpu_offset()	(current_thread_info()->per_cpu_offset)
+
+#endif /* _ASMARM_PERCPU_H_ */
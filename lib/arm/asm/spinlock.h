@@ -1,11 +1,8 @@
 #ifndef _ASMARM_SPINLOCK_H_
 #define _ASMARM_SPINLOCK_H_
 
-struct spinlock {
-	int v;
-};
-
-extern void spin_lock(struct spinlock *lock);
-extern void spin_unlock(struct spinlock *lock);
+/* spin_lock() can't use exclusives while the MMU is off */
+#define HAVE_ARCH_SPINLOCK
+#include <asm-generic/spinlock.h>
 
 #endif /* _ASMARM_SPINLOCK_H_ */
@@ -0,0 +1,8 @@
+#ifndef _ASMARM_STRING_H_
+#define _ASMARM_STRING_H_
+
+#ifndef __STRING_H
+#error Do not directly include <asm/string.h>. Just use <string.h>.
+#endif
+
+#endif
@@ -48,6 +48,7 @@ struct thread_info {
 	int cpu;
 	unsigned int flags;
 	void *pgtable;
+	unsigned long per_cpu_offset;
 #ifdef __arm__
 	exception_fn exception_handlers[EXCPTN_MAX];
 #else
@@ -47,27 +47,20 @@ static bool
 gic_get_dt_bases(const char *compatible, void **base1, void **base2)
 {
 	struct dt_pbus_reg reg;
-	struct dt_device gic;
-	struct dt_bus bus;
 	int node, ret, i;
 
-	dt_bus_init_defaults(&bus);
-	dt_device_init(&gic, &bus, NULL);
-
-	node = dt_device_find_compatible(&gic, compatible);
+	node = dt_node_offset_by_compatible(-1, compatible);
 	assert(node >= 0 || node == -FDT_ERR_NOTFOUND);
 
 	if (node == -FDT_ERR_NOTFOUND)
 		return false;
 
-	dt_device_bind_node(&gic, node);
-
-	ret = dt_pbus_translate(&gic, 0, &reg);
+	ret = dt_pbus_translate_node(node, 0, &reg);
 	assert(ret == 0);
 	*base1 = ioremap(reg.addr, reg.size);
 
 	for (i = 0; i < GICV3_NR_REDISTS; ++i) {
-		ret = dt_pbus_translate(&gic, i + 1, &reg);
+		ret = dt_pbus_translate_node(node, i + 1, &reg);
 		if (ret == -FDT_ERR_NOTFOUND)
 			break;
 		assert(ret == 0);
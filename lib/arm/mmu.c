@@ -117,12 +117,102 @@ pteval_t *install_page(pgd_t *pgtable, phys_addr_t phys, void *virt)
 				 __pgprot(PTE_WBWA | PTE_USER));
 }
 
+static bool pmd_sect(pmd_t *pmd)
+{
+	return (pmd_val(*pmd) & PMD_TYPE_MASK) == PMD_TYPE_SECT;
+}
+
 phys_addr_t virt_to_pte_phys(pgd_t *pgtable, void *mem)
 {
+	pgd_t *pgd = pgd_offset(pgtable, (uintptr_t)mem);
+	pmd_t *pmd = pmd_alloc(pgd, (uintptr_t)mem);
+
+	if (pmd_sect(pmd))
+		return (pmd_val(*pmd) & PHYS_MASK & PMD_MASK) +
+		       ((ulong)mem & ~PMD_MASK);
 	return (*get_pte(pgtable, (uintptr_t)mem) & PHYS_MASK & -PAGE_SIZE)
 		+ ((ulong)mem & (PAGE_SIZE - 1));
 }
 
+/*
+ * Walks the tables once per PMD_SIZE rather than once per page, and with
+ * MAP_BLOCKS maps aligned PMD_SIZE chunks with a section.  The TLB is
+ * flushed once.
+ */
+void map_range(pgd_t *pgtable, void *virt, phys_addr_t phys, size_t len,
+	       unsigned int prot)
+{
+	uintptr_t vaddr = (uintptr_t)virt;
+	pteval_t attr = PTE_WBWA | PTE_AF | PTE_SHARED;
+	pgd_t *pgd;
+	pmd_t *pmd;
+	pte_t *pte;
+
+	assert(vaddr % PAGE_SIZE == 0 && phys % PAGE_SIZE == 0);
+	assert(len % PAGE_SIZE == 0);
+
+	if (prot & MAP_USER)
+		attr |= PTE_USER;
+	if (!(prot & MAP_WRITE))
+		attr |= PTE_RDONLY;
+
+	while (len) {
+		pgd = pgd_offset(pgtable, vaddr);
+		pmd = pmd_alloc(pgd, vaddr);
+		if ((prot & MAP_BLOCKS) && pmd_none(*pmd) &&
+		    (vaddr | phys) % PMD_SIZE == 0 && len >= PMD_SIZE) {
+			pmd_val(*pmd) = phys | PMD_TYPE_SECT | attr;
+			flush_dcache_addr((ulong)pmd);
+			vaddr += PMD_SIZE;
+			phys += PMD_SIZE;
+			len -= PMD_SIZE;
+			continue;
+		}
+
+		assert_msg(!pmd_sect(pmd), "%p is mapped by a section",
+			   (void *)vaddr);
+		pte = pte_alloc(pmd, vaddr);
+		do {
+			pte_val(*pte) = phys | PTE_TYPE_PAGE | attr;
+			flush_dcache_addr((ulong)pte);
+			pte++;
+			vaddr += PAGE_SIZE;
+			phys += PAGE_SIZE;
+			len -= PAGE_SIZE;
+		} while (len && vaddr % PMD_SIZE);
+	}
+	flush_tlb_all();
+}
+
+/* flush_tlb_all() is broadcast, so all the CPUs' TLBs are clean */
+bool unmap_range(pgd_t *pgtable, void *virt, size_t len)
+{
+	uintptr_t vaddr = (uintptr_t)virt;
+	size_t off, size;
+	pgd_t *pgd;
+	pmd_t *pmd;
+	pteval_t *p_pte;
+
+	for (off = 0; off < len; off += size) {
+		pgd = pgd_offset(pgtable, vaddr + off);
+		pmd = pmd_alloc(pgd, vaddr + off);
+		if (pmd_sect(pmd)) {
+			size = PMD_SIZE;
+			assert_msg((vaddr + off) % size == 0 && off + size <= len,
+				   "%p + %#lx splits a section", virt, len);
+			pmd_val(*pmd) = 0;
+			flush_dcache_addr((ulong)pmd);
+			continue;
+		}
+		size = PAGE_SIZE;
+		p_pte = get_pte(pgtable, vaddr + off);
+		*p_pte = 0;
+		flush_dcache_addr((ulong)p_pte);
+	}
+	flush_tlb_all();
+	return true;
+}
+
 void mmu_set_range_ptes(pgd_t *pgtable, uintptr_t virt_offset,
 			phys_addr_t phys_start, phys_addr_t phys_end,
 			pgprot_t prot)
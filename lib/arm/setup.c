@@ -17,6 +17,7 @@
 #include <alloc_phys.h>
 #include <alloc_page.h>
 #include <argv.h>
+#include <percpu.h>
 #include <asm/thread_info.h>
 #include <asm/setup.h>
 #include <asm/page.h>
@@ -171,6 +172,9 @@ void setup(const void *fdt)
 	/* cpu_init must be called before thread_info_init */
 	thread_info_init(current_thread_info(), 0);
 
+	/* secondaries get their per-CPU offset from thread_info_init */
+	percpu_init(nr_cpus, current_thread_info()->cpu);
+
 	/* mem_init must be called before io_init */
 	io_init();
 
@@ -1,6 +1,10 @@
 /*
  * ARM spinlock implementation
  *
+ * Exclusive accesses only work on Normal memory, and all memory is
+ * Device memory while the MMU is off, so until it is on, locks are
+ * taken with plain stores; there is a single CPU then anyway.
+ *
  * This code is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Library General Public License version 2.
  */
@@ -11,31 +15,22 @@
 
 void spin_lock(struct spinlock *lock)
 {
-	u32 val, fail;
-
 	if (!mmu_enabled()) {
 		lock->v = 1;
 		smp_mb();
 		return;
 	}
 
-	do {
-		asm volatile(
-		"1:	ldrex	%0, [%2]\n"
-		"	teq	%0, #0\n"
-		"	bne	1b\n"
-		"	mov	%0, #1\n"
-		"	strex	%1, %0, [%2]\n"
-		: "=&r" (val), "=&r" (fail)
-		: "r" (&lock->v)
-		: "cc" );
-	} while (fail);
-
-	smp_mb();
+	__spin_lock(lock);
 }
 
 void spin_unlock(struct spinlock *lock)
 {
-	smp_mb();
-	lock->v = 0;
+	if (!mmu_enabled()) {
+		smp_mb();
+		lock->v = 0;
+		return;
+	}
+
+	__spin_unlock(lock);
 }
@@ -6,6 +6,7 @@
  * This work is licensed under the terms of the GNU LGPL, version 2.
  */
 #include <libcflat.h>
+#include <percpu.h>
 #include <asm/ptrace.h>
 #include <asm/processor.h>
 #include <asm/thread_info.h>
@@ -228,6 +229,7 @@ static void __thread_info_init(struct thread_info *ti, unsigned int flags)
 	memset(ti, 0, sizeof(struct thread_info));
 	ti->cpu = mpidr_to_cpu(get_mpidr());
 	ti->flags = flags;
+	ti->per_cpu_offset = per_cpu_offset(ti->cpu);
 }
 
 void thread_info_init(struct thread_info *ti, unsigned int flags)
@@ -0,0 +1,85 @@
+/*
+ * arm64 string functions
+ *
+ * The bulk of each operation is done 16 bytes at a time with STP, or
+ * LDP/STP, and zeroing uses DC ZVA by whole blocks when it's allowed.
+ * Everything is kept naturally aligned: with the MMU off all memory is
+ * Device memory, where unaligned accesses and DC ZVA fault, so DC ZVA
+ * is only used with the MMU on, and LDP/STP copies need src and dest
+ * to be equally aligned.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#include <libcflat.h>
+#include <asm/sysreg.h>
+#include <asm/mmu.h>
+
+#define DCZID_DZP	(1 << 4)
+#define DCZID_BS_MASK	0xf
+
+/* The DC ZVA block size, or 0 if DC ZVA can't be used */
+static size_t zva_size(void)
+{
+	u64 dczid = read_sysreg(dczid_el0);
+
+	if ((dczid & DCZID_DZP) || !mmu_enabled())
+		return 0;
+	return 4ul << (dczid & DCZID_BS_MASK);
+}
+
+void *memset(void *s, int c, size_t n)
+{
+	u64 v = (u8)c * 0x0101010101010101ul;
+	u8 *p = s;
+	size_t zva;
+
+	for (; n && (uintptr_t)p % 16; n--)
+		*p++ = c;
+
+	if (!c && (zva = zva_size()) && n >= 2 * zva) {
+		for (; (uintptr_t)p % zva; p += 16, n -= 16)
+			asm volatile("stp %1, %1, [%0]" : : "r" (p), "r" (v)
+				     : "memory");
+		for (; n >= zva; p += zva, n -= zva)
+			asm volatile("dc zva, %0" : : "r" (p) : "memory");
+	}
+
+	for (; n >= 16; p += 16, n -= 16)
+		asm volatile("stp %1, %1, [%0]" : : "r" (p), "r" (v)
+			     : "memory");
+	while (n--)
+		*p++ = c;
+
+	return s;
+}
+
+/* Copies forwards, so it also does for memmove() with dest below src. */
+void *memcpy(void *dest, const void *src, size_t n)
+{
+	const u8 *s = src;
+	u8 *d = dest;
+	u64 a, b;
+
+	if (((uintptr_t)d ^ (uintptr_t)s) % 16 == 0) {
+		for (; n && (uintptr_t)d % 16; n--)
+			*d++ = *s++;
+		for (; n >= 16; n -= 16) {
+			asm volatile(
+			"	ldp	%0, %1, [%2], #16\n"
+			"	stp	%0, %1, [%3], #16\n"
+			: "=&r" (a), "=&r" (b), "+r" (s), "+r" (d)
+			: : "memory");
+		}
+	}
+	while (n--)
+		*d++ = *s++;
+
+	return dest;
+}
+
+void *memmove(void *dest, const void *src, size_t n)
+{
+	if (dest <= src || dest >= src + n)
+		return memcpy(dest, src, n);
+	return generic_memmove(dest, src, n);
+}
@@ -0,0 +1,11 @@
+#ifndef _ASM_GENERIC_PERCPU_H_
+#define _ASM_GENERIC_PERCPU_H_
+/*
+ * Architectures without a register or per-CPU page to keep their
+ * per-CPU offset in look it up by smp_processor_id().
+ */
+#include <asm/smp.h>
+
+#define __my_cpu_offset()	per_cpu_offset(smp_processor_id())
+
+#endif
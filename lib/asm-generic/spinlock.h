@@ -1,18 +1,102 @@
 #ifndef _ASM_GENERIC_SPINLOCK_H_
 #define _ASM_GENERIC_SPINLOCK_H_
+/*
+ * Spinlocks come in three flavours, which all share struct spinlock,
+ * in which all zeroes means unlocked:
+ *
+ * - tas: test-and-test-and-set.  Cheap, but unfair: a waiter can
+ *   starve while others keep taking the lock.
+ * - ticket: waiters take a ticket and are served in order.
+ * - mcs: queued, as in Linux's qspinlock.  Waiters are served in order
+ *   too, but each of them spins on its own per-CPU node rather than on
+ *   the lock, and the node is given back once the lock is taken.
+ *
+ * spin_lock() and spin_unlock() use the flavour chosen with configure's
+ * --spinlock option, ticket by default.  Tests may call the flavours
+ * directly, as long as each lock is only ever used with one of them.
+ */
+#include "config.h"
+#include <asm/barrier.h>
 
 struct spinlock {
-    unsigned int v;
+	union {
+		unsigned int v;		/* tas and mcs */
+		struct {
+			unsigned short next;
+			unsigned short owner;
+		};			/* ticket */
+	};
 };
 
+static inline void tas_spin_lock(struct spinlock *lock)
+{
+	while (__sync_lock_test_and_set(&lock->v, 1)) {
+		while (*(volatile unsigned int *)&lock->v)
+			cpu_relax();
+	}
+}
+
+static inline void tas_spin_unlock(struct spinlock *lock)
+{
+	__sync_lock_release(&lock->v);
+}
+
+static inline void ticket_spin_lock(struct spinlock *lock)
+{
+	unsigned short ticket = __sync_fetch_and_add(&lock->next, 1);
+
+	while (*(volatile unsigned short *)&lock->owner != ticket)
+		cpu_relax();
+	__sync_synchronize();
+}
+
+static inline void ticket_spin_unlock(struct spinlock *lock)
+{
+	__sync_synchronize();
+	/* only the holder writes owner */
+	*(volatile unsigned short *)&lock->owner = lock->owner + 1;
+}
+
+#define MCS_LOCKED	1u
+
+extern void mcs_spin_lock_slow(struct spinlock *lock);
+
+static inline void mcs_spin_lock(struct spinlock *lock)
+{
+	if (!__sync_bool_compare_and_swap(&lock->v, 0, MCS_LOCKED))
+		mcs_spin_lock_slow(lock);
+}
+
+static inline void mcs_spin_unlock(struct spinlock *lock)
+{
+	/* the tail may be changing under our feet */
+	__sync_fetch_and_and(&lock->v, ~MCS_LOCKED);
+}
+
+#if defined(CONFIG_SPINLOCK_TAS)
+#define __spin_lock		tas_spin_lock
+#define __spin_unlock		tas_spin_unlock
+#elif defined(CONFIG_SPINLOCK_MCS)
+#define __spin_lock		mcs_spin_lock
+#define __spin_unlock		mcs_spin_unlock
+#else
+#define __spin_lock		ticket_spin_lock
+#define __spin_unlock		ticket_spin_unlock
+#endif
+
+#ifndef HAVE_ARCH_SPINLOCK
 static inline void spin_lock(struct spinlock *lock)
 {
-	while (__sync_lock_test_and_set(&lock->v, 1));
+	__spin_lock(lock);
 }
 
 static inline void spin_unlock(struct spinlock *lock)
 {
-	__sync_lock_release(&lock->v);
+	__spin_unlock(lock);
 }
+#else
+extern void spin_lock(struct spinlock *lock);
+extern void spin_unlock(struct spinlock *lock);
+#endif
 
 #endif
@@ -0,0 +1,144 @@
+/*
+ * Micro-benchmark harness
+ *
+ * bench_run() first doubles the number of operations per sample until
+ * a sample takes 1/BENCH_SAMPLES of the time budget, which also warms
+ * up caches and predictors, and then takes up to BENCH_SAMPLES samples
+ * of that size.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#include "bench.h"
+
+#define BENCH_SAMPLES		128
+#define BENCH_BUDGET_MS		250
+/* the budget when the counter rate is unknown, about as long on x86 */
+#define BENCH_BUDGET_CYCLES	(1ull << 30)
+#define BENCH_MAX_ITERS		(1ull << 40)
+
+#define NSEC_PER_SEC		1000000000ull
+
+void bench_reset(struct bench *b)
+{
+	b->iters = 1;
+	b->count = b->ops = 0;
+	b->min = b->max = b->sum = 0;
+	b->stride = 1;
+	b->nr = 0;
+}
+
+void bench_record(struct bench *b, u64 cycles)
+{
+	unsigned int i;
+
+	/* a zeroed struct bench is as good as a reset one */
+	if (!b->stride)
+		b->stride = 1;
+
+	if (!b->count || cycles < b->min)
+		b->min = cycles;
+	if (cycles > b->max)
+		b->max = cycles;
+	b->sum += cycles;
+
+	if (b->count++ % b->stride)
+		return;
+
+	if (b->nr == BENCH_KEPT) {
+		/* keep every other sample, now and from now on */
+		for (i = 0; i < BENCH_KEPT / 2; i++)
+			b->kept[i] = b->kept[2 * i];
+		b->nr = BENCH_KEPT / 2;
+		b->stride *= 2;
+	}
+	b->kept[b->nr++] = cycles;
+}
+
+static u64 bench_budget(void)
+{
+	u64 hz = bench_cycles_hz();
+
+	return hz ? hz / 1000 * BENCH_BUDGET_MS : BENCH_BUDGET_CYCLES;
+}
+
+void bench_run(struct bench *b, bench_fn fn, void *data)
+{
+	u64 budget = bench_budget();
+	u64 iters = 1, elapsed = 0, start, t;
+
+	bench_reset(b);
+
+	for (;;) {
+		start = bench_cycles();
+		fn(data, iters);
+		t = bench_cycles() - start;
+		b->ops += iters;
+		if (t >= budget / BENCH_SAMPLES || iters >= BENCH_MAX_ITERS)
+			break;
+		iters *= 2;
+	}
+
+	b->iters = iters;
+	while (b->count < BENCH_SAMPLES && elapsed < 2 * budget) {
+		start = bench_cycles();
+		fn(data, iters);
+		t = bench_cycles() - start;
+		b->ops += iters;
+		bench_record(b, t);
+		elapsed += t;
+	}
+}
+
+/* Sorts the kept samples, which doesn't bother bench_record() */
+u64 bench_percentile(struct bench *b, unsigned int pct)
+{
+	unsigned int gap, i, j, idx;
+	u64 v;
+
+	if (!b->nr)
+		return 0;
+
+	for (gap = b->nr / 2; gap; gap /= 2) {
+		for (i = gap; i < b->nr; i++) {
+			v = b->kept[i];
+			for (j = i; j >= gap && b->kept[j - gap] > v; j -= gap)
+				b->kept[j] = b->kept[j - gap];
+			b->kept[j] = v;
+		}
+	}
+
+	idx = (b->nr * pct + 99) / 100;
+	return b->kept[idx ? idx - 1 : 0];
+}
+
+/* The time @cycles of the counter take, or 0 if its rate is unknown */
+u64 bench_cycles_to_ns(u64 cycles)
+{
+	u64 hz = bench_cycles_hz();
+
+	if (!hz)
+		return 0;
+	return cycles / hz * NSEC_PER_SEC + cycles % hz * NSEC_PER_SEC / hz;
+}
+
+static u64 per_op(struct bench *b, u64 cycles)
+{
+	u64 v = bench_cycles_hz() ? bench_cycles_to_ns(cycles) : cycles;
+
+	return v / (b->iters ? b->iters : 1);
+}
+
+void bench_report(const char *name, struct bench *b)
+{
+	const char *unit = bench_cycles_hz() ? "ns" : "cycles";
+	char metric[64];
+
+	if (!b->count)
+		return;
+
+	report_perf(name, per_op(b, bench_percentile(b, 50)), unit);
+	snprintf(metric, sizeof(metric), "%s.min", name);
+	report_perf(metric, per_op(b, b->min), unit);
+	snprintf(metric, sizeof(metric), "%s.p99", name);
+	report_perf(metric, per_op(b, bench_percentile(b, 99)), unit);
+}
@@ -0,0 +1,49 @@
+/*
+ * Micro-benchmark harness
+ *
+ * A struct bench collects timed samples, each of which covers @iters
+ * operations, and reports the cost of one operation as PERF lines:
+ *
+ *   PERF: <name> <median> <unit>
+ *   PERF: <name>.min <min> <unit>
+ *   PERF: <name>.p99 <99th percentile> <unit>
+ *
+ * The unit is "ns" when the frequency of the arch's counter is known,
+ * and "cycles" of the counter otherwise.
+ *
+ * bench_run() does the whole job for operations that can be repeated
+ * back to back.  Tests that time each operation themselves, e.g. across
+ * a VM entry, feed the samples to bench_record() instead.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include "libcflat.h"
+#include <asm/bench.h>
+
+/* Samples kept for the percentiles; more are thinned out evenly */
+#define BENCH_KEPT	512
+
+struct bench {
+	u64 iters;		/* operations per sample */
+	u64 count;		/* samples recorded */
+	u64 ops;		/* operations run, warmup included */
+	u64 min, max, sum;
+	u64 stride;		/* one sample in @stride is kept */
+	unsigned int nr;
+	u64 kept[BENCH_KEPT];
+};
+
+/* Run @iters operations */
+typedef void (*bench_fn)(void *data, u64 iters);
+
+extern void bench_reset(struct bench *b);
+extern void bench_record(struct bench *b, u64 cycles);
+extern void bench_run(struct bench *b, bench_fn fn, void *data);
+extern u64 bench_percentile(struct bench *b, unsigned int pct);
+extern u64 bench_cycles_to_ns(u64 cycles);
+extern void bench_report(const char *name, struct bench *b);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef CONFIG_H
+#define CONFIG_H 1
+/*
+ * Generated file. DO NOT MODIFY.
+ *
+ */
+
+#define CONFIG_SPINLOCK_TICKET 1
+
+#endif
@@ -9,6 +9,44 @@
 
 static const void *fdt;
 
+/*
+ * An index of the tree, built by dt_init(), so that lookups don't walk
+ * the flattened tree each time.  Nodes are kept in tree order, which is
+ * offset order, and compatible strings and phandles are hashed.  Each
+ * compatible string has its nodes in a run of compat_nodes[], in tree
+ * order too, so the next node with it is a binary search away.  Trees
+ * with more than DT_INDEX_NODES nodes or DT_INDEX_COMPATS compatible
+ * strings, or nested deeper than DT_INDEX_DEPTH, aren't indexed, and
+ * lookups fall back to libfdt.
+ */
+#define DT_INDEX_NODES		1024
+#define DT_INDEX_COMPATS	1024
+#define DT_INDEX_DEPTH		32
+#define DT_INDEX_HASH		2048	/* at most half full */
+
+struct dt_index_node {
+	int offset;
+	int parent;		/* index of the parent, -1 for the root */
+	int sibling;		/* index of the next sibling, or -1 */
+	u32 phandle;
+};
+
+struct dt_index_compat {
+	const char *compatible;
+	int first, nr;		/* its nodes in compat_nodes[] */
+};
+
+static struct {
+	bool valid;
+	int nr_nodes, nr_compats, nr_compat_nodes;
+	struct dt_index_node nodes[DT_INDEX_NODES];
+	struct dt_index_compat compats[DT_INDEX_COMPATS];
+	int compat_nodes[DT_INDEX_COMPATS];
+	/* entry + 1, zero for none */
+	int compat_hash[DT_INDEX_HASH];
+	int phandle_hash[DT_INDEX_HASH];
+} dt_index;
+
 const void *dt_fdt(void)
 {
 	return fdt;
@@ -19,6 +57,282 @@ bool dt_available(void)
 	return fdt_check_header(fdt) == 0;
 }
 
+static unsigned int dt_hash_str(const char *s)
+{
+	unsigned int h = 2166136261u;
+
+	while (*s)
+		h = (h ^ (unsigned char)*s++) * 16777619u;
+	return h;
+}
+
+/* The slot of the first node with @compatible, or the empty one for it */
+static int *dt_index_compat_slot(const char *compatible)
+{
+	unsigned int h = dt_hash_str(compatible);
+	int *slot;
+
+	for (;; h++) {
+		slot = &dt_index.compat_hash[h % DT_INDEX_HASH];
+		if (!*slot || !strcmp(dt_index.compats[*slot - 1].compatible,
+				      compatible))
+			return slot;
+	}
+}
+
+static int *dt_index_phandle_slot(u32 phandle)
+{
+	unsigned int h = phandle;
+	int *slot;
+
+	for (;; h++) {
+		slot = &dt_index.phandle_hash[h % DT_INDEX_HASH];
+		if (!*slot || dt_index.nodes[*slot - 1].phandle == phandle)
+			return slot;
+	}
+}
+
+static int dt_index_build(void)
+{
+	int parents[DT_INDEX_DEPTH], prev[DT_INDEX_DEPTH];
+	struct dt_index_compat *c;
+	struct dt_index_node *n;
+	int offset, depth = 0, len, i, first, *slot;
+	const char *compat, *end;
+
+	memset(&dt_index, 0, sizeof(dt_index));
+	prev[0] = -1;
+
+	for (offset = 0; offset >= 0 && depth >= 0;
+	     offset = fdt_next_node(fdt, offset, &depth)) {
+
+		if (dt_index.nr_nodes == DT_INDEX_NODES ||
+		    depth >= DT_INDEX_DEPTH)
+			return -FDT_ERR_NOSPACE;
+
+		i = dt_index.nr_nodes++;
+		n = &dt_index.nodes[i];
+		n->offset = offset;
+		n->parent = depth ? parents[depth - 1] : -1;
+		n->sibling = -1;
+
+		if (prev[depth] >= 0)
+			dt_index.nodes[prev[depth]].sibling = i;
+		prev[depth] = i;
+		parents[depth] = i;
+		if (depth + 1 < DT_INDEX_DEPTH)
+			prev[depth + 1] = -1;
+
+		n->phandle = fdt_get_phandle(fdt, offset);
+		if (n->phandle && n->phandle != (u32)-1) {
+			slot = dt_index_phandle_slot(n->phandle);
+			if (!*slot)
+				*slot = i + 1;
+		}
+	}
+	if (offset < 0 && offset != -FDT_ERR_NOTFOUND)
+		return offset;
+
+	/*
+	 * Count the nodes of each compatible string, give each string its
+	 * run of compat_nodes[], then fill the runs in tree order.
+	 */
+	for (i = 0; i < dt_index.nr_nodes; i++) {
+		compat = fdt_getprop(fdt, dt_index.nodes[i].offset,
+				     "compatible", &len);
+		if (!compat)
+			continue;
+
+		for (end = compat + len; compat < end;
+		     compat += strlen(compat) + 1) {
+			if (dt_index.nr_compat_nodes == DT_INDEX_COMPATS)
+				return -FDT_ERR_NOSPACE;
+			dt_index.nr_compat_nodes++;
+			slot = dt_index_compat_slot(compat);
+			if (!*slot) {
+				c = &dt_index.compats[dt_index.nr_compats++];
+				c->compatible = compat;
+				*slot = dt_index.nr_compats;
+			}
+			dt_index.compats[*slot - 1].nr++;
+		}
+	}
+
+	for (i = 0, first = 0; i < dt_index.nr_compats; i++) {
+		c = &dt_index.compats[i];
+		c->first = first;
+		first += c->nr;
+		c->nr = 0;
+	}
+
+	for (i = 0; i < dt_index.nr_nodes; i++) {
+		compat = fdt_getprop(fdt, dt_index.nodes[i].offset,
+				     "compatible", &len);
+		if (!compat)
+			continue;
+
+		for (end = compat + len; compat < end;
+		     compat += strlen(compat) + 1) {
+			c = &dt_index.compats[*dt_index_compat_slot(compat) - 1];
+			dt_index.compat_nodes[c->first + c->nr++] = i;
+		}
+	}
+
+	return 0;
+}
+
+/* The index of the node at @offset, or -1 */
+static int dt_index_find(int offset)
+{
+	int lo = 0, hi = dt_index.nr_nodes - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (dt_index.nodes[mid].offset == offset)
+			return mid;
+		if (dt_index.nodes[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return -1;
+}
+
+static int dt_index_first_child(int i)
+{
+	if (i + 1 < dt_index.nr_nodes && dt_index.nodes[i + 1].parent == i)
+		return i + 1;
+	return -1;
+}
+
+/* Node names match as in libfdt, where "name" also matches "name@addr" */
+static bool dt_index_name_eq(int i, const char *s, int len)
+{
+	const char *name = fdt_get_name(fdt, dt_index.nodes[i].offset, NULL);
+
+	if (!name || memcmp(name, s, len))
+		return false;
+	return name[len] == '\0' || (name[len] == '@' && !memchr(s, '@', len));
+}
+
+int dt_path_offset(const char *path)
+{
+	const char *p = path, *q;
+	int i = 0;
+
+	/* aliases are rare enough to leave to libfdt */
+	if (!dt_index.valid || *path != '/')
+		return fdt_path_offset(fdt, path);
+
+	while (*p) {
+		while (*p == '/')
+			p++;
+		if (!*p)
+			break;
+
+		q = strchr(p, '/');
+		if (!q)
+			q = p + strlen(p);
+
+		for (i = dt_index_first_child(i); i >= 0;
+		     i = dt_index.nodes[i].sibling)
+			if (dt_index_name_eq(i, p, q - p))
+				break;
+		if (i < 0)
+			return -FDT_ERR_NOTFOUND;
+
+		p = q;
+	}
+
+	return dt_index.nodes[i].offset;
+}
+
+int dt_parent_offset(int fdtnode)
+{
+	int i;
+
+	if (!dt_index.valid)
+		return fdt_parent_offset(fdt, fdtnode);
+
+	i = dt_index_find(fdtnode);
+	if (i < 0)
+		return -FDT_ERR_BADOFFSET;
+	if (dt_index.nodes[i].parent < 0)
+		return -FDT_ERR_NOTFOUND;
+	return dt_index.nodes[dt_index.nodes[i].parent].offset;
+}
+
+int dt_first_subnode(int fdtnode)
+{
+	int i;
+
+	if (!dt_index.valid)
+		return fdt_first_subnode(fdt, fdtnode);
+
+	i = dt_index_find(fdtnode);
+	if (i < 0)
+		return -FDT_ERR_BADOFFSET;
+	i = dt_index_first_child(i);
+	return i < 0 ? -FDT_ERR_NOTFOUND : dt_index.nodes[i].offset;
+}
+
+int dt_next_subnode(int fdtnode)
+{
+	int i;
+
+	if (!dt_index.valid)
+		return fdt_next_subnode(fdt, fdtnode);
+
+	i = dt_index_find(fdtnode);
+	if (i < 0)
+		return -FDT_ERR_BADOFFSET;
+	i = dt_index.nodes[i].sibling;
+	return i < 0 ? -FDT_ERR_NOTFOUND : dt_index.nodes[i].offset;
+}
+
+int dt_node_offset_by_compatible(int startoffset, const char *compatible)
+{
+	struct dt_index_compat *c;
+	int slot, lo, hi, mid, *nodes;
+
+	if (!dt_index.valid)
+		return fdt_node_offset_by_compatible(fdt, startoffset,
+						     compatible);
+
+	slot = *dt_index_compat_slot(compatible);
+	if (!slot)
+		return -FDT_ERR_NOTFOUND;
+
+	/* the first of the string's nodes past @startoffset */
+	c = &dt_index.compats[slot - 1];
+	nodes = &dt_index.compat_nodes[c->first];
+	lo = 0;
+	hi = c->nr;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (dt_index.nodes[nodes[mid]].offset > startoffset)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo < c->nr ? dt_index.nodes[nodes[lo]].offset
+			  : -FDT_ERR_NOTFOUND;
+}
+
+int dt_node_offset_by_phandle(u32 phandle)
+{
+	int slot;
+
+	if (!dt_index.valid)
+		return fdt_node_offset_by_phandle(fdt, phandle);
+
+	if (!phandle || phandle == (u32)-1)
+		return -FDT_ERR_BADPHANDLE;
+
+	slot = *dt_index_phandle_slot(phandle);
+	return slot ? dt_index.nodes[slot - 1].offset : -FDT_ERR_NOTFOUND;
+}
+
 int dt_get_nr_cells(int fdtnode, u32 *nr_address_cells, u32 *nr_size_cells)
 {
 	const struct fdt_property *prop;
@@ -87,7 +401,7 @@ int dt_pbus_translate_node(int fdtnode, int regidx,
 	u32 nac, nsc;
 	int parent, ret;
 
-	parent = fdt_parent_offset(fdt, fdtnode);
+	parent = dt_parent_offset(fdtnode);
 	if (parent < 0)
 		return parent;
 
@@ -144,14 +458,14 @@ int dt_device_find_compatible(const struct dt_device *dev,
 {
 	int node, ret;
 
-	node = fdt_node_offset_by_compatible(fdt, -1, compatible);
+	node = dt_node_offset_by_compatible(-1, compatible);
 	while (node >= 0) {
 		ret = dev->bus->match(dev, node);
 		if (ret < 0)
 			return ret;
 		else if (ret)
 			break;
-		node = fdt_node_offset_by_compatible(fdt, node, compatible);
+		node = dt_node_offset_by_compatible(node, compatible);
 	}
 	return node;
 }
@@ -211,7 +525,7 @@ int dt_for_each_cpu_node(void (*func)(int fdtnode, u64 regval, void *info),
 	u32 nac, nsc;
 	u64 regval;
 
-	cpus = fdt_path_offset(fdt, "/cpus");
+	cpus = dt_path_offset("/cpus");
 	if (cpus < 0)
 		return cpus;
 
@@ -251,7 +565,7 @@ int dt_get_bootargs(const char **bootargs)
 
 	*bootargs = NULL;
 
-	node = fdt_path_offset(fdt, "/chosen");
+	node = dt_path_offset("/chosen");
 	if (node < 0)
 		return node;
 
@@ -268,7 +582,7 @@ int dt_get_default_console_node(void)
 	const struct fdt_property *prop;
 	int node, len;
 
-	node = fdt_path_offset(fdt, "/chosen");
+	node = dt_path_offset("/chosen");
 	if (node < 0)
 		return node;
 
@@ -279,7 +593,7 @@ int dt_get_default_console_node(void)
 			return len;
 	}
 
-	return fdt_path_offset(fdt, prop->data);
+	return dt_path_offset(prop->data);
 }
 
 int dt_get_initrd(const char **initrd, u32 *size)
@@ -292,7 +606,7 @@ int dt_get_initrd(const char **initrd, u32 *size)
 	*initrd = NULL;
 	*size = 0;
 
-	node = fdt_path_offset(fdt, "/chosen");
+	node = dt_path_offset("/chosen");
 	if (node < 0)
 		return node;
 
@@ -330,5 +644,6 @@ int dt_init(const void *fdt_ptr)
 		return ret;
 
 	fdt = fdt_ptr;
+	dt_index.valid = dt_index_build() == 0;
 	return 0;
 }
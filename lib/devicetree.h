@@ -26,11 +26,62 @@ extern const void *dt_fdt(void);
 /* check for an initialized, valid devicetree */
 extern bool dt_available(void);
 
+/*
+ * dt_init indexes the tree, and the following lookups answer from the
+ * index.  They behave as their libfdt counterparts, which they fall
+ * back to if the tree was too big to index.
+ */
+
+/*
+ * dt_path_offset finds the node at @path
+ * returns
+ *  - node (>= 0) on success
+ *  - a negative FDT_ERR_* value on failure
+ */
+extern int dt_path_offset(const char *path);
+
+/*
+ * dt_parent_offset finds the parent of @fdtnode
+ * returns
+ *  - node (>= 0) on success
+ *  - a negative FDT_ERR_* value on failure
+ */
+extern int dt_parent_offset(int fdtnode);
+
+/*
+ * dt_node_offset_by_compatible finds the first @compatible node after
+ * @startoffset, or the first one at all if @startoffset is -1
+ * returns
+ *  - node (>= 0) on success
+ *  - a negative FDT_ERR_* value on failure
+ */
+extern int dt_node_offset_by_compatible(int startoffset,
+					const char *compatible);
+
+/*
+ * dt_node_offset_by_phandle finds the node with @phandle
+ * returns
+ *  - node (>= 0) on success
+ *  - a negative FDT_ERR_* value on failure
+ */
+extern int dt_node_offset_by_phandle(u32 phandle);
+
+/*
+ * dt_first_subnode and dt_next_subnode find the first child of
+ * @fdtnode, and the next sibling of @fdtnode
+ * returns
+ *  - node (>= 0) on success
+ *  - -FDT_ERR_NOTFOUND when there are none
+ *  - another negative FDT_ERR_* value on failure
+ */
+extern int dt_first_subnode(int fdtnode);
+extern int dt_next_subnode(int fdtnode);
+
 /* traverse child nodes */
 #define dt_for_each_subnode(n, s)					\
-	for (s = fdt_first_subnode(dt_fdt(), n);			\
+	for (s = dt_first_subnode(n);					\
 	     s != -FDT_ERR_NOTFOUND;					\
-	     s = fdt_next_subnode(dt_fdt(), s))
+	     s = dt_next_subnode(s))
 
 /**********************************************************************
  * Abstractions for required node types and properties
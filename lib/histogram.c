@@ -0,0 +1,136 @@
+/*
+ * Log-linear latency histograms
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#include "histogram.h"
+#include "asm-generic/atomic.h"
+
+static unsigned int hist_index(u64 value)
+{
+	unsigned int shift;
+
+	if (value < HIST_SUB_BUCKETS)
+		return value;
+
+	shift = 63 - __builtin_clzll(value);
+	if (shift >= HIST_MAX_SHIFT)
+		return HIST_BUCKETS - 1;
+
+	/* the top HIST_SUB_BITS + 1 bits, less the leading one */
+	return (shift - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS +
+	       (value >> (shift - HIST_SUB_BITS)) - HIST_SUB_BUCKETS;
+}
+
+/* The highest value that goes into bucket @idx */
+static u64 hist_bucket_max(unsigned int idx)
+{
+	unsigned int shift = idx / HIST_SUB_BUCKETS;
+	u64 sub = idx % HIST_SUB_BUCKETS;
+
+	if (!shift)
+		return idx;
+	shift--;
+	return ((HIST_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+static void atomic_max_u64(u64 *p, u64 value)
+{
+	u64 old = *p, prev;
+
+	while (old < value) {
+		prev = __sync_val_compare_and_swap(p, old, value);
+		if (prev == old)
+			break;
+		old = prev;
+	}
+}
+
+void hist_reset(struct histogram *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+void hist_record(struct histogram *h, u64 value)
+{
+	atomic_fetch_inc(&h->buckets[hist_index(value)]);
+	atomic_fetch_inc(&h->count);
+	atomic_fetch_add(&h->sum, value);
+	atomic_max_u64(&h->max, value);
+	atomic_max_u64(&h->min_inv, ~value);
+}
+
+void hist_merge(struct histogram *dst, const struct histogram *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->count += src->count;
+	dst->sum += src->sum;
+	dst->max = MAX(dst->max, src->max);
+	dst->min_inv = MAX(dst->min_inv, src->min_inv);
+}
+
+u64 hist_min(const struct histogram *h)
+{
+	return h->count ? ~h->min_inv : 0;
+}
+
+/*
+ * The value below which @permille thousandths of the samples are, with
+ * the precision of the buckets.
+ */
+u64 hist_permille(const struct histogram *h, unsigned int permille)
+{
+	u64 rank, seen = 0;
+	unsigned int i;
+
+	if (!h->count)
+		return 0;
+
+	rank = (h->count * permille + 999) / 1000;
+	if (!rank)
+		return hist_min(h);
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+	return MAX(MIN(hist_bucket_max(i), h->max), hist_min(h));
+}
+
+/*
+ * Print the median as <name>, and <name>.{min,avg,p90,p99,p999,max},
+ * as PERF lines.
+ */
+void hist_report(const char *name, const struct histogram *h,
+		 const char *unit)
+{
+	static const struct {
+		const char *suffix;
+		unsigned int permille;
+	} pcts[] = {
+		{ "p90", 900 },
+		{ "p99", 990 },
+		{ "p999", 999 },
+	};
+	char metric[64];
+	unsigned int i;
+
+	if (!h->count)
+		return;
+
+	report_perf(name, hist_permille(h, 500), unit);
+	snprintf(metric, sizeof(metric), "%s.min", name);
+	report_perf(metric, hist_min(h), unit);
+	snprintf(metric, sizeof(metric), "%s.avg", name);
+	report_perf(metric, h->sum / h->count, unit);
+	for (i = 0; i < ARRAY_SIZE(pcts); i++) {
+		snprintf(metric, sizeof(metric), "%s.%s", name, pcts[i].suffix);
+		report_perf(metric, hist_permille(h, pcts[i].permille), unit);
+	}
+	snprintf(metric, sizeof(metric), "%s.max", name);
+	report_perf(metric, h->max, unit);
+}
@@ -0,0 +1,46 @@
+/*
+ * Log-linear latency histograms
+ *
+ * Values below HIST_SUB_BUCKETS get a bucket each, and every power of
+ * two above is split into HIST_SUB_BUCKETS buckets, so that a bucket is
+ * never wider than 1/HIST_SUB_BUCKETS of its values, as in HDR
+ * histograms.  Values from 2^HIST_MAX_SHIFT on share the last bucket,
+ * but min and max are exact.
+ *
+ * hist_record() is lock-free and can be called from interrupt handlers.
+ * It is meant for one histogram per CPU: CPUs recording into the same
+ * histogram don't lose samples, but bounce its cachelines.  Recording
+ * must be over before hist_merge() and the percentiles are used.
+ *
+ * A zeroed struct histogram is empty.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include "libcflat.h"
+
+#define HIST_SUB_BITS		5
+#define HIST_SUB_BUCKETS	(1 << HIST_SUB_BITS)
+#define HIST_MAX_SHIFT		40
+#define HIST_BUCKETS \
+	((HIST_MAX_SHIFT - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+struct histogram {
+	u64 count;
+	u64 sum;
+	u64 max;
+	u64 min_inv;		/* ~min, so that zero means none */
+	u32 buckets[HIST_BUCKETS];
+};
+
+extern void hist_reset(struct histogram *h);
+extern void hist_record(struct histogram *h, u64 value);
+extern void hist_merge(struct histogram *dst, const struct histogram *src);
+extern u64 hist_min(const struct histogram *h);
+extern u64 hist_permille(const struct histogram *h, unsigned int permille);
+extern void hist_report(const char *name, const struct histogram *h,
+			const char *unit);
+
+#endif
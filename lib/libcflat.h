@@ -110,6 +110,7 @@ extern void report_skip(const char *msg_fmt, ...)
 					__attribute__((format(printf, 1, 2)));
 extern void report_info(const char *msg_fmt, ...)
 					__attribute__((format(printf, 1, 2)));
+extern void report_perf(const char *metric, u64 value, const char *unit);
 extern void report_pass(void);
 extern int report_summary(void);
 
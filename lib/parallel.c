@@ -0,0 +1,219 @@
+/*
+ * Work distribution across CPUs
+ *
+ * Each CPU's deque has a bottom, where its owner pushes and pops, and
+ * a top, where the other CPUs steal.  Only the owner moves the bottom;
+ * the top only moves forward, with a compare-and-swap, so that the
+ * owner and the thieves agree on who got the last task.  The tasks are
+ * copied in and out of the deque, which is safe as the owner doesn't
+ * push over a task that a thief may still be copying, see task_push().
+ *
+ * @pending counts the tasks that were spawned and aren't done yet, so
+ * the CPUs keep looking for work until it drops to zero.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#include "libcflat.h"
+#include "parallel.h"
+#include "percpu.h"
+#include "asm-generic/atomic.h"
+#include <asm/barrier.h>
+#include <asm/smp.h>
+
+#define TASK_DEQUE_SIZE	64
+
+struct task {
+	task_fn fn;
+	void *data;
+	unsigned long begin, end;
+};
+
+struct task_deque {
+	long top;
+	long bottom __attribute__((aligned(64)));
+	bool running;
+	struct task tasks[TASK_DEQUE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct task_deque, task_deque);
+static struct task_deque *deques[TASK_CPUS];
+static int nr_deques;
+static unsigned long pending;
+static struct task root;
+static bool tasks_running;
+
+/*
+ * The top may be behind, as a thief can steal at any time, but not
+ * ahead: a thief is done copying a task before it moves the top past
+ * it, so a full deque is never pushed over a task being stolen.
+ */
+static bool task_push(struct task_deque *dq, const struct task *task)
+{
+	long b = dq->bottom;
+
+	if (b - *(volatile long *)&dq->top >= TASK_DEQUE_SIZE)
+		return false;
+
+	dq->tasks[b % TASK_DEQUE_SIZE] = *task;
+	smp_wmb();
+	*(volatile long *)&dq->bottom = b + 1;
+	return true;
+}
+
+static bool task_pop(struct task_deque *dq, struct task *task)
+{
+	long b = dq->bottom - 1, t;
+	bool ok = true;
+
+	/* claim the bottom task before looking at how far the thieves got */
+	*(volatile long *)&dq->bottom = b;
+	__sync_synchronize();
+	t = *(volatile long *)&dq->top;
+
+	if (t > b) {
+		*(volatile long *)&dq->bottom = b + 1;
+		return false;
+	}
+
+	*task = dq->tasks[b % TASK_DEQUE_SIZE];
+	if (t == b) {
+		/* the last task, which a thief may be after too */
+		ok = __sync_bool_compare_and_swap(&dq->top, t, t + 1);
+		*(volatile long *)&dq->bottom = b + 1;
+	}
+	return ok;
+}
+
+static bool task_steal(struct task_deque *dq, struct task *task)
+{
+	long t = *(volatile long *)&dq->top, b;
+
+	__sync_synchronize();
+	b = *(volatile long *)&dq->bottom;
+	if (t >= b)
+		return false;
+
+	smp_rmb();
+	*task = dq->tasks[t % TASK_DEQUE_SIZE];
+	return __sync_bool_compare_and_swap(&dq->top, t, t + 1);
+}
+
+static void task_run(const struct task *task)
+{
+	task->fn(task->data, task->begin, task->end);
+	atomic_fetch_dec(&pending);
+}
+
+/*
+ * Queue a task on the running CPU, for it or another CPU to run.  Out
+ * of tasks_run(), or when the deque is full, the task runs right away.
+ */
+void task_spawn(task_fn fn, void *data, unsigned long begin,
+		unsigned long end)
+{
+	struct task_deque *dq = this_cpu_ptr(&task_deque);
+	struct task task = {
+		.fn = fn,
+		.data = data,
+		.begin = begin,
+		.end = end,
+	};
+
+	atomic_fetch_inc(&pending);
+	if (!dq->running || !task_push(dq, &task))
+		task_run(&task);
+}
+
+static void task_worker(void *data)
+{
+	struct task_deque *dq = this_cpu_ptr(&task_deque);
+	struct task_deque *victim_dq;
+	struct task task;
+	int id, victim, nr;
+
+	id = atomic_fetch_inc(&nr_deques);
+	if (id >= TASK_CPUS)
+		return;
+
+	dq->top = dq->bottom = 0;
+	dq->running = true;
+	smp_wmb();
+	*(struct task_deque * volatile *)&deques[id] = dq;
+
+	/* the first CPU in starts the work, the others steal from it */
+	if (id == 0)
+		task_run(&root);
+
+	victim = id;
+	while (*(volatile unsigned long *)&pending) {
+		if (task_pop(dq, &task)) {
+			task_run(&task);
+			continue;
+		}
+
+		nr = MIN(*(volatile int *)&nr_deques, TASK_CPUS);
+		victim = (victim + 1) % nr;
+		victim_dq = *(struct task_deque * volatile *)&deques[victim];
+		if (victim != id && victim_dq && task_steal(victim_dq, &task))
+			task_run(&task);
+		else
+			cpu_relax();
+	}
+
+	dq->running = false;
+}
+
+void tasks_run(task_fn fn, void *data, unsigned long begin,
+	       unsigned long end)
+{
+	assert(!tasks_running);
+	tasks_running = true;
+
+	root.fn = fn;
+	root.data = data;
+	root.begin = begin;
+	root.end = end;
+	memset(deques, 0, sizeof(deques));
+	nr_deques = 0;
+	pending = 1;
+	smp_wmb();
+
+	on_cpus(task_worker, NULL);
+	tasks_running = false;
+}
+
+struct parallel_for {
+	task_fn fn;
+	void *data;
+	unsigned long chunk;
+};
+
+static void parallel_for_split(void *data, unsigned long begin,
+			       unsigned long end)
+{
+	struct parallel_for *pf = data;
+	unsigned long chunks, mid;
+
+	while ((chunks = (end - begin - 1) / pf->chunk + 1) > 1) {
+		mid = begin + chunks / 2 * pf->chunk;
+		task_spawn(parallel_for_split, pf, mid, end);
+		end = mid;
+	}
+	pf->fn(pf->data, begin, end);
+}
+
+void parallel_for(unsigned long begin, unsigned long end,
+		  unsigned long chunk, task_fn fn, void *data)
+{
+	struct parallel_for pf = {
+		.fn = fn,
+		.data = data,
+		.chunk = chunk,
+	};
+
+	assert(chunk);
+	if (begin >= end)
+		return;
+
+	tasks_run(parallel_for_split, &pf, begin, end);
+}
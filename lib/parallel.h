@@ -0,0 +1,42 @@
+/*
+ * Work distribution across CPUs
+ *
+ * tasks_run() runs a task and all the tasks it spawns on every CPU,
+ * and returns once they are all done.  Each CPU pushes the tasks it
+ * spawns onto its own deque and pops them back, last in first out;
+ * CPUs whose deque is empty steal the oldest task of another CPU.
+ * The deques are lock-free, as in Chase and Lev's "Dynamic Circular
+ * Work-Stealing Deque", but of a fixed size: a task spawned onto a
+ * full deque runs right away.
+ *
+ * A task calls fn(data, begin, end); tasks that have no use for a
+ * range can ignore @begin and @end.
+ *
+ * parallel_for() calls fn on chunks of [begin, end) of at most @chunk
+ * iterations, on every CPU.  The range is split in halves, the upper
+ * of which is spawned, until it is down to a chunk, so that a CPU that
+ * steals takes the biggest piece of work left.
+ *
+ * These use on_cpus(), so the CPUs must be brought up first, with
+ * smp_init() on x86.  Only one tasks_run() at a time, and only up to
+ * TASK_CPUS CPUs take part in it.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include "libcflat.h"
+
+#define TASK_CPUS	256
+
+typedef void (*task_fn)(void *data, unsigned long begin, unsigned long end);
+
+extern void task_spawn(task_fn fn, void *data, unsigned long begin,
+		       unsigned long end);
+extern void tasks_run(task_fn fn, void *data, unsigned long begin,
+		      unsigned long end);
+extern void parallel_for(unsigned long begin, unsigned long end,
+			 unsigned long chunk, task_fn fn, void *data);
+
+#endif
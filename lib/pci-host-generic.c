@@ -72,15 +72,14 @@ static struct pci_host_bridge *pci_dt_probe(void)
 	dt_bus_init_defaults(&dt_bus);
 	dt_device_init(&dt_dev, &dt_bus, NULL);
 
-	node = fdt_path_offset(fdt, "/");
+	node = dt_path_offset("/");
 	assert(node >= 0);
 
 	ret = dt_get_nr_cells(node, &nac_root, &nsc_root);
 	assert(ret == 0);
 	assert(nac_root == 1 || nac_root == 2);
 
-	node = fdt_node_offset_by_compatible(fdt, node,
-					     "pci-host-ecam-generic");
+	node = dt_node_offset_by_compatible(node, "pci-host-ecam-generic");
 	if (node == -FDT_ERR_NOTFOUND) {
 		printf("No PCIe ECAM compatible controller found\n");
 		return NULL;
@@ -0,0 +1,64 @@
+/*
+ * Per-CPU areas
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#include "libcflat.h"
+#include "alloc.h"
+#include "percpu.h"
+
+extern char __per_cpu_start[], __per_cpu_end[];
+
+static unsigned long *per_cpu_offsets;
+static int nr_per_cpu_ids;
+static int per_cpu_boot_id;
+
+unsigned long per_cpu_offset(int id)
+{
+	if (!per_cpu_offsets)
+		return 0;
+
+	assert(id >= 0 && id < nr_per_cpu_ids);
+	return per_cpu_offsets[id];
+}
+
+int percpu_boot_id(void)
+{
+	return per_cpu_boot_id;
+}
+
+void percpu_init(int nr_ids, int boot_id)
+{
+	unsigned long size = __per_cpu_end - __per_cpu_start;
+	unsigned long *offsets;
+	char *area = NULL;
+	int id;
+
+	assert(boot_id >= 0 && boot_id < nr_ids);
+
+	/* a second SMP bring-up keeps the areas of the first */
+	if (per_cpu_offsets)
+		return;
+
+	offsets = calloc(nr_ids, sizeof(*offsets));
+	assert(offsets);
+
+	size = ALIGN(size, PER_CPU_ALIGN);
+	if (size && nr_ids > 1) {
+		area = memalign(PER_CPU_ALIGN, size * (nr_ids - 1));
+		assert(area);
+		memset(area, 0, size * (nr_ids - 1));
+	}
+
+	for (id = 0; id < nr_ids; id++) {
+		if (id == boot_id || !area)
+			continue;
+		offsets[id] = (unsigned long)area -
+			      (unsigned long)__per_cpu_start;
+		area += size;
+	}
+
+	nr_per_cpu_ids = nr_ids;
+	per_cpu_boot_id = boot_id;
+	per_cpu_offsets = offsets;
+}
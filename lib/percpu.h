@@ -0,0 +1,49 @@
+/*
+ * Per-CPU variables
+ *
+ * DEFINE_PER_CPU(type, name) defines a variable of which each CPU has
+ * its own copy.  this_cpu_ptr(&name) points to the running CPU's copy,
+ * and per_cpu_ptr(&name, id) to the copy of the CPU whose
+ * smp_processor_id() is @id.
+ *
+ * The boot CPU's copies are the ones in the image, in the .bss.percpu
+ * section.  percpu_init() gives the other CPUs theirs at SMP bring-up,
+ * and until then they share the boot CPU's.  Each CPU's copies start
+ * out zeroed, so per-CPU variables can't have initializers, and sit in
+ * cachelines of their own, so that CPUs don't false-share them.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#ifndef _PERCPU_H_
+#define _PERCPU_H_
+
+#include "libcflat.h"
+#include <asm/percpu.h>
+
+#define PER_CPU_ALIGN		64
+
+#define DEFINE_PER_CPU(type, name) \
+	__attribute__((section(".bss.percpu"))) __typeof__(type) name
+#define DECLARE_PER_CPU(type, name) \
+	extern __typeof__(type) name
+
+#define __per_cpu_ptr(ptr, offset) \
+	((__typeof__(ptr))((unsigned long)(ptr) + (offset)))
+#define per_cpu_ptr(ptr, id)	__per_cpu_ptr(ptr, per_cpu_offset(id))
+#define this_cpu_ptr(ptr)	__per_cpu_ptr(ptr, __my_cpu_offset())
+
+/*
+ * percpu_init allocates the areas of the CPUs whose ids are below
+ * @nr_ids, but @boot_id's, which keeps the image's.  It is called by the
+ * architecture's SMP bring-up, which then points each CPU at its area,
+ * see asm/percpu.h.
+ */
+extern void percpu_init(int nr_ids, int boot_id);
+
+/* per_cpu_offset is the offset of CPU @id's area from the boot CPU's */
+extern unsigned long per_cpu_offset(int id);
+
+/* The boot CPU's id as given to percpu_init(), or 0 before it was called */
+extern int percpu_boot_id(void);
+
+#endif /* _PERCPU_H_ */
@@ -0,0 +1,22 @@
+#ifndef _ASMPOWERPC_BENCH_H_
+#define _ASMPOWERPC_BENCH_H_
+
+#ifndef _BENCH_H_
+#error Do not directly include <asm/bench.h>. Just use <bench.h>.
+#endif
+
+#include <asm/processor.h>
+#include <asm/setup.h>
+
+/* The timebase, whose frequency comes from the device tree */
+static inline u64 bench_cycles(void)
+{
+	return get_tb();
+}
+
+static inline u64 bench_cycles_hz(void)
+{
+	return tb_hz;
+}
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef _ASMPOWERPC_PERCPU_H_
+#define _ASMPOWERPC_PERCPU_H_
+
+#ifndef _PERCPU_H_
+#error Do not directly include <asm/percpu.h>. Just use <percpu.h>.
+#endif
+
+#include <asm-generic/percpu.h>
+
+#endif /* _ASMPOWERPC_PERCPU_H_ */
@@ -5,6 +5,16 @@
 
 extern int nr_threads;
 
+/* The hardware thread, from the Processor Identification Register */
+static inline int smp_processor_id(void)
+{
+	int pir;
+
+	asm volatile ("mfspr %[pir],1023" : [pir] "=r" (pir));
+
+	return pir;
+}
+
 struct start_threads {
 	int nr_threads;
 	int nr_started;
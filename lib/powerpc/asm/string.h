@@ -0,0 +1,8 @@
+#ifndef _ASMPOWERPC_STRING_H_
+#define _ASMPOWERPC_STRING_H_
+
+#ifndef __STRING_H
+#error Do not directly include <asm/string.h>. Just use <string.h>.
+#endif
+
+#endif
@@ -21,7 +21,7 @@ static struct spinlock rtas_lock;
 
 static int rtas_node(void)
 {
-	int node = fdt_path_offset(dt_fdt(), "/rtas");
+	int node = dt_path_offset("/rtas");
 
 	if (node < 0) {
 		printf("%s: /rtas: %s\n", __func__, fdt_strerror(node));
@@ -16,6 +16,7 @@
 #include <alloc.h>
 #include <alloc_phys.h>
 #include <argv.h>
+#include <percpu.h>
 #include <asm/setup.h>
 #include <asm/page.h>
 #include <asm/hcall.h>
@@ -38,8 +39,11 @@ struct cpu_set_params {
 	unsigned icache_bytes;
 	unsigned dcache_bytes;
 	uint64_t tb_hz;
+	u32 max_thread_id;
 };
 
+static u32 max_thread_id;
+
 #define EXCEPTION_STACK_SIZE	(32*1024) /* 32kB */
 
 static char exception_stack[NR_CPUS][EXCEPTION_STACK_SIZE];
@@ -48,12 +52,20 @@ static void cpu_set(int fdtnode, u64 regval, void *info)
 {
 	static bool read_common_info = false;
 	struct cpu_set_params *params = info;
-	int cpu = nr_cpus++;
+	const struct fdt_property *threads;
+	int cpu = nr_cpus++, len, i;
 
 	assert_msg(cpu < NR_CPUS, "Number cpus exceeds maximum supported (%d).", NR_CPUS);
 
 	cpus[cpu] = regval;
 
+	threads = fdt_get_property(dt_fdt(), fdtnode,
+				   "ibm,ppc-interrupt-server#s", &len);
+	assert(threads != NULL);
+	for (i = 0; i < len / 4; i++)
+		params->max_thread_id = MAX(params->max_thread_id,
+			fdt32_to_cpu(((u32 *)threads->data)[i]));
+
 	/* set exception stack address for this CPU (in SPGR0) */
 	asm volatile ("mtsprg0 %[addr]" ::
 		      [addr] "r" (exception_stack[cpu + 1]));
@@ -90,11 +102,13 @@ static void cpu_init(void)
 	int ret;
 
 	nr_cpus = 0;
+	params.max_thread_id = 0;
 	ret = dt_for_each_cpu_node(cpu_set, &params);
 	assert(ret == 0);
 	__icache_bytes = params.icache_bytes;
 	__dcache_bytes = params.dcache_bytes;
 	tb_hz = params.tb_hz;
+	max_thread_id = params.max_thread_id;
 
 	/* Interrupt Endianness */
 
@@ -201,6 +215,9 @@ void setup(const void *fdt)
 	/* cpu_init must be called before mem_init */
 	mem_init(PAGE_ALIGN((unsigned long)freemem));
 
+	/* per-CPU areas are indexed by thread id, like smp_processor_id() */
+	percpu_init(max_thread_id + 1, smp_processor_id());
+
 	/* mem_init must be called before io_init */
 	io_init();
 
@@ -0,0 +1 @@
+#include "../../powerpc/asm/percpu.h"
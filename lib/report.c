@@ -12,47 +12,154 @@
 
 #include "libcflat.h"
 #include "asm/spinlock.h"
-
-static unsigned int tests, failures, xfailures, skipped;
-static char prefixes[256];
-static struct spinlock lock;
+#include "asm/barrier.h"
+#include "asm/smp.h"
+#include "asm-generic/atomic.h"
+#include "percpu.h"
 
 #define PREFIX_DELIMITER ": "
+#define PREFIXES_MAX 256
+
+/*
+ * Each CPU has its own prefix stack and its own counters, so that the
+ * CPUs of an SMP test can report at the same time without taking a lock
+ * and without pushing onto each other's prefixes.  The counters are
+ * updated with atomics, as interrupt handlers may report too, and are
+ * added up by report_summary().  Results are printed with a single
+ * puts(), so the lines of different CPUs don't get mixed up.
+ *
+ * The boot CPU, which runs main(), has slot 0, whatever its id, and the
+ * CPU with id 0 takes the boot CPU's slot instead.  The reports of the
+ * other CPUs are prefixed with the prefixes of the boot CPU and then with
+ * their own.  CPUs with ids past REPORT_CPUS share the last slot.
+ */
+#define REPORT_CPUS 256
+
+struct report_cpu {
+	char prefixes[PREFIXES_MAX];
+	unsigned int tests, failures, xfailures, skipped;
+} __attribute__((aligned(64)));
+
+static struct report_cpu report_cpus[REPORT_CPUS];
+
+static struct report_cpu *this_report_cpu(void)
+{
+	unsigned int cpu = smp_processor_id();
+	unsigned int boot = percpu_boot_id();
+
+	if (cpu == boot)
+		cpu = 0;
+	else if (cpu == 0)
+		cpu = boot;
+	return &report_cpus[cpu < REPORT_CPUS ? cpu : REPORT_CPUS - 1];
+}
+
+/* Write the full prefixes of @rc to @buf, which has 2 * PREFIXES_MAX bytes */
+static void get_prefixes(struct report_cpu *rc, char *buf)
+{
+	int len = 0;
+
+	if (rc != &report_cpus[0])
+		len = snprintf(buf, PREFIXES_MAX, "%s", report_cpus[0].prefixes);
+	snprintf(buf + len, PREFIXES_MAX, "%s", rc->prefixes);
+}
+
+/*
+ * In quiet mode, selected with REPORT_QUIET=1 in the environment, only
+ * failures are printed as they happen.  Everything else is counted per
+ * prefix, and the counts are printed by report_summary().  If there are
+ * more prefixes than PREFIX_STATS_MAX, the results of the remaining ones
+ * are printed as in the normal mode.
+ *
+ * Entries are only ever appended, under stats_lock, and published by
+ * incrementing nr_prefix_stats, so they are looked up without the lock.
+ */
+#define PREFIX_STATS_MAX 64
+
+struct prefix_stats {
+	char prefix[2 * PREFIXES_MAX];
+	unsigned int passed, failed, skipped;
+};
+
+static struct prefix_stats prefix_stats[PREFIX_STATS_MAX];
+static unsigned int nr_prefix_stats;
+static struct spinlock stats_lock;
+static int quiet = -1;
+
+static bool report_quiet(void)
+{
+	char *s;
+
+	if (quiet < 0) {
+		s = getenv("REPORT_QUIET");
+		quiet = s && atol(s) != 0;
+	}
+	return quiet;
+}
+
+static struct prefix_stats *find_prefix_stats(const char *prefix,
+					      unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		if (!strcmp(prefix_stats[i].prefix, prefix))
+			return &prefix_stats[i];
+	}
+	return NULL;
+}
+
+/* The counters of @prefix, or NULL if the table is full */
+static struct prefix_stats *get_prefix_stats(const char *prefix)
+{
+	struct prefix_stats *ps;
+	unsigned int nr = nr_prefix_stats;
+
+	smp_rmb();
+	ps = find_prefix_stats(prefix, nr);
+	if (ps)
+		return ps;
+
+	spin_lock(&stats_lock);
+	ps = find_prefix_stats(prefix, nr_prefix_stats);
+	if (!ps && nr_prefix_stats < PREFIX_STATS_MAX) {
+		ps = &prefix_stats[nr_prefix_stats];
+		strcpy(ps->prefix, prefix);
+		smp_wmb();
+		nr_prefix_stats++;
+	}
+	spin_unlock(&stats_lock);
+
+	return ps;
+}
 
 void report_pass(void)
 {
-	spin_lock(&lock);
-	tests++;
-	spin_unlock(&lock);
+	atomic_fetch_inc(&this_report_cpu()->tests);
 }
 
 void report_prefix_pushf(const char *prefix_fmt, ...)
 {
+	char *prefixes = this_report_cpu()->prefixes;
 	va_list va;
 	unsigned int len;
 	int start;
 
-	spin_lock(&lock);
-
 	len = strlen(prefixes);
-	assert_msg(len < sizeof(prefixes), "%d >= %zu", len, sizeof(prefixes));
+	assert_msg(len < PREFIXES_MAX, "%d >= %d", len, PREFIXES_MAX);
 	start = len;
 
 	va_start(va, prefix_fmt);
-	len += vsnprintf(&prefixes[len], sizeof(prefixes) - len, prefix_fmt,
-			 va);
+	len += vsnprintf(&prefixes[len], PREFIXES_MAX - len, prefix_fmt, va);
 	va_end(va);
-	assert_msg(len < sizeof(prefixes), "%d >= %zu", len, sizeof(prefixes));
+	assert_msg(len < PREFIXES_MAX, "%d >= %d", len, PREFIXES_MAX);
 
 	assert_msg(!strstr(&prefixes[start], PREFIX_DELIMITER),
 		   "Prefix \"%s\" contains delimiter \"" PREFIX_DELIMITER "\"",
 		   &prefixes[start]);
 
-	len += snprintf(&prefixes[len], sizeof(prefixes) - len,
-			PREFIX_DELIMITER);
-	assert_msg(len < sizeof(prefixes), "%d >= %zu", len, sizeof(prefixes));
-
-	spin_unlock(&lock);
+	len += snprintf(&prefixes[len], PREFIXES_MAX - len, PREFIX_DELIMITER);
+	assert_msg(len < PREFIXES_MAX, "%d >= %d", len, PREFIXES_MAX);
 }
 
 void report_prefix_push(const char *prefix)
@@ -62,46 +169,68 @@ void report_prefix_push(const char *prefix)
 
 void report_prefix_pop(void)
 {
+	char *prefixes = this_report_cpu()->prefixes;
 	char *p, *q;
 
-	spin_lock(&lock);
-
-	if (!*prefixes) {
-		spin_unlock(&lock);
+	if (!*prefixes)
 		return;
-	}
 
 	for (p = prefixes, q = strstr(p, PREFIX_DELIMITER) + 2;
 			*q;
 			p = q, q = strstr(p, PREFIX_DELIMITER) + 2)
 		;
 	*p = '\0';
+}
 
-	spin_unlock(&lock);
+/* Print "<tag>: <prefixes><msg>\n" with a single puts() */
+static void print_line(const char *tag, const char *prefixes,
+		       const char *msg_fmt, va_list va)
+{
+	char line[1024];
+	int len;
+
+	/* keep room for the newline, even if the message is truncated */
+	len = snprintf(line, sizeof(line) - 1, "%s: %s", tag, prefixes);
+	len = MIN(len, (int)sizeof(line) - 2);
+	len += vsnprintf(line + len, sizeof(line) - 1 - len, msg_fmt, va);
+	len = MIN(len, (int)sizeof(line) - 2);
+	line[len] = '\n';
+	line[len + 1] = '\0';
+	puts(line);
 }
 
 static void va_report(const char *msg_fmt,
 		bool pass, bool xfail, bool skip, va_list va)
 {
-	const char *prefix = skip ? "SKIP"
-				  : xfail ? (pass ? "XPASS" : "XFAIL")
-					  : (pass ? "PASS"  : "FAIL");
-
-	spin_lock(&lock);
-
-	tests++;
-	printf("%s: ", prefix);
-	puts(prefixes);
-	vprintf(msg_fmt, va);
-	puts("\n");
+	const char *tag = skip ? "SKIP"
+			       : xfail ? (pass ? "XPASS" : "XFAIL")
+				       : (pass ? "PASS"  : "FAIL");
+	bool failed = !skip && (xfail ? pass : !pass);
+	struct report_cpu *rc = this_report_cpu();
+	struct prefix_stats *ps = NULL;
+	char prefixes[2 * PREFIXES_MAX];
+
+	get_prefixes(rc, prefixes);
+
+	atomic_fetch_inc(&rc->tests);
+	if (report_quiet())
+		ps = get_prefix_stats(prefixes);
+	if (ps) {
+		if (skip)
+			atomic_fetch_inc(&ps->skipped);
+		else if (failed)
+			atomic_fetch_inc(&ps->failed);
+		else
+			atomic_fetch_inc(&ps->passed);
+	}
+	if (!ps || failed)
+		print_line(tag, prefixes, msg_fmt, va);
 	if (skip)
-		skipped++;
+		atomic_fetch_inc(&rc->skipped);
 	else if (xfail && !pass)
-		xfailures++;
+		atomic_fetch_inc(&rc->xfailures);
 	else if (xfail || !pass)
-		failures++;
-
-	spin_unlock(&lock);
+		atomic_fetch_inc(&rc->failures);
 }
 
 void report(const char *msg_fmt, bool pass, ...)
@@ -130,23 +259,56 @@ void report_skip(const char *msg_fmt, ...)
 
 void report_info(const char *msg_fmt, ...)
 {
+	char prefixes[2 * PREFIXES_MAX];
 	va_list va;
 
-	spin_lock(&lock);
-	puts("INFO: ");
-	puts(prefixes);
+	if (report_quiet())
+		return;
+
+	get_prefixes(this_report_cpu(), prefixes);
 	va_start(va, msg_fmt);
-	vprintf(msg_fmt, va);
+	print_line("INFO", prefixes, msg_fmt, va);
 	va_end(va);
-	puts("\n");
-	spin_unlock(&lock);
+}
+
+/*
+ * Emit a "PERF: <metric> <value> <unit>" line, which run_tests.sh picks
+ * up into its structured results.  The metric must not contain spaces.
+ */
+void report_perf(const char *metric, u64 value, const char *unit)
+{
+	printf("PERF: %s %" PRIu64 " %s\n", metric, value, unit);
+}
+
+static void print_prefix_stats(void)
+{
+	struct prefix_stats *ps;
+	unsigned int i;
+
+	for (i = 0; i < nr_prefix_stats; i++) {
+		ps = &prefix_stats[i];
+		printf("PREFIX: %s%d passed", ps->prefix, ps->passed);
+		if (ps->failed)
+			printf(", %d failed", ps->failed);
+		if (ps->skipped)
+			printf(", %d skipped", ps->skipped);
+		printf("\n");
+	}
 }
 
 int report_summary(void)
 {
-	int ret;
-	spin_lock(&lock);
+	unsigned int tests = 0, failures = 0, xfailures = 0, skipped = 0;
+	struct report_cpu *rc;
+
+	for (rc = report_cpus; rc < report_cpus + REPORT_CPUS; rc++) {
+		tests += rc->tests;
+		failures += rc->failures;
+		xfailures += rc->xfailures;
+		skipped += rc->skipped;
+	}
 
+	print_prefix_stats();
 	printf("SUMMARY: %d tests", tests);
 	if (failures)
 		printf(", %d unexpected failures", failures);
@@ -157,29 +319,23 @@ int report_summary(void)
 	printf("\n");
 
 	if (tests == skipped) {
-		spin_unlock(&lock);
 		/* Blame AUTOTOOLS for using 77 for skipped test and QEMU for
 		 * mangling error codes in a way that gets 77 if we ... */
 		return 77 >> 1;
 	}
 
-	ret = failures > 0 ? 1 : 0;
-	spin_unlock(&lock);
-	return ret;
+	return failures > 0 ? 1 : 0;
 }
 
 void report_abort(const char *msg_fmt, ...)
 {
+	char prefixes[2 * PREFIXES_MAX];
 	va_list va;
 
-	spin_lock(&lock);
-	puts("ABORT: ");
-	puts(prefixes);
+	get_prefixes(this_report_cpu(), prefixes);
 	va_start(va, msg_fmt);
-	vprintf(msg_fmt, va);
+	print_line("ABORT", prefixes, msg_fmt, va);
 	va_end(va);
-	puts("\n");
-	spin_unlock(&lock);
 	report_summary();
 	abort();
 }
@@ -0,0 +1,24 @@
+#ifndef _ASMS390X_BENCH_H_
+#define _ASMS390X_BENCH_H_
+
+#ifndef _BENCH_H_
+#error Do not directly include <asm/bench.h>. Just use <bench.h>.
+#endif
+
+/* Bit 51 of the TOD clock is incremented every microsecond */
+#define TOD_CLOCK_HZ	(4096ul * 1000 * 1000)
+
+static inline u64 bench_cycles(void)
+{
+	u64 clk;
+
+	asm volatile(" stckf %0 " : "=Q"(clk) : : "cc");
+	return clk;
+}
+
+static inline u64 bench_cycles_hz(void)
+{
+	return TOD_CLOCK_HZ;
+}
+
+#endif
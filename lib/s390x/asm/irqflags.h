@@ -0,0 +1,25 @@
+#ifndef _ASMS390X_IRQFLAGS_H_
+#define _ASMS390X_IRQFLAGS_H_
+/*
+ * local_irq_save() masks I/O and external interrupts on the calling CPU
+ * and returns the previous PSW mask, which local_irq_restore() puts
+ * back.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#include <asm/arch_def.h>
+
+static inline unsigned long local_irq_save(void)
+{
+	uint64_t mask = extract_psw_mask();
+
+	load_psw_mask(mask & ~(PSW_MASK_IO | PSW_MASK_EXT));
+	return mask;
+}
+
+static inline void local_irq_restore(unsigned long flags)
+{
+	load_psw_mask(flags);
+}
+
+#endif
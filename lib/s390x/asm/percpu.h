@@ -0,0 +1,20 @@
+#ifndef _ASMS390X_PERCPU_H_
+#define _ASMS390X_PERCPU_H_
+
+#ifndef _PERCPU_H_
+#error Do not directly include <asm/percpu.h>. Just use <percpu.h>.
+#endif
+
+#include <asm/arch_def.h>
+
+/*
+ * Each CPU's lowcore is at address 0 through its prefix, and
+ * smp_cpu_setup() puts the CPU's offset in it.
+ */
+static inline unsigned long __my_cpu_offset(void)
+{
+	return *(volatile unsigned long *)offsetof(struct lowcore,
+						   percpu_offset);
+}
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ * This code is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Library General Public License version 2.
+ */
+#ifndef _ASMS390X_SMP_H_
+#define _ASMS390X_SMP_H_
+
+#include <asm/arch_def.h>
+#include "../smp.h"
+
+/* The CPU address, which is what the SIGP orders use too */
+#define smp_processor_id()	stap()
+
+#endif
@@ -82,6 +82,54 @@ pteval_t *install_page(pgd_t *pgtable, phys_addr_t phys, void *vaddr)
 	return set_pte(pgtable, __pa(phys), vaddr);
 }
 
+/*
+ * Walks the tables once per page table, i.e. per segment, rather than
+ * once per page.  Large pages would need EDAT, which isn't enabled, so
+ * all leaves are 4K pages and MAP_BLOCKS has no effect.  There is no
+ * user/supervisor distinction, so MAP_USER has no effect either.
+ */
+void map_range(pgd_t *pgtable, void *vaddr, phys_addr_t phys, size_t len,
+	       unsigned int prot)
+{
+	uintptr_t va = (uintptr_t)vaddr;
+	pteval_t flags = prot & MAP_WRITE ? 0 : PAGE_ENTRY_P;
+	pteval_t *p_pte;
+
+	assert(va % PAGE_SIZE == 0 && phys % PAGE_SIZE == 0);
+	assert(len % PAGE_SIZE == 0);
+
+	while (len) {
+		p_pte = get_pte(pgtable, va);
+		do {
+			/* first flush the old entry (if we're replacing anything) */
+			if (!(*p_pte & PAGE_ENTRY_I))
+				ipte(va, p_pte);
+			*p_pte = phys | flags;
+			p_pte++;
+			va += PAGE_SIZE;
+			phys += PAGE_SIZE;
+			len -= PAGE_SIZE;
+		} while (len && va % (1UL << SEGMENT_SHIFT));
+	}
+}
+
+/*
+ * IPTE invalidates the entry and purges it from the TLBs of all CPUs in
+ * one go, so there is nothing left to batch here.
+ */
+bool unmap_range(pgd_t *pgtable, void *vaddr, size_t len)
+{
+	size_t off;
+	pteval_t *p_pte;
+
+	for (off = 0; off < len; off += PAGE_SIZE) {
+		p_pte = get_pte(pgtable, (uintptr_t)vaddr + off);
+		if (!(*p_pte & PAGE_ENTRY_I))
+			ipte((uintptr_t)vaddr + off, p_pte);
+	}
+	return true;
+}
+
 void protect_page(void *vaddr, unsigned long prot)
 {
 	pteval_t *p_pte = get_pte(table_root, (uintptr_t)vaddr);
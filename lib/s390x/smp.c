@@ -21,6 +21,7 @@
 
 #include <alloc.h>
 #include <alloc_page.h>
+#include <percpu.h>
 
 #include "smp.h"
 #include "sclp.h"
@@ -180,6 +181,7 @@ int smp_cpu_setup(uint16_t addr, struct psw psw)
 
 	/* Copy all exception psws. */
 	memcpy(lc, cpu0->lowcore, 512);
+	lc->percpu_offset = per_cpu_offset(cpu->addr);
 
 	/* Setup stack */
 	cpu->stack = (uint64_t *)alloc_pages(2);
@@ -201,6 +203,59 @@ out:
 	return rc;
 }
 
+static void (*on_cpus_func)(void *data);
+static void *on_cpus_data;
+static int on_cpus_done;
+
+static void on_cpus_entry(void)
+{
+	on_cpus_func(on_cpus_data);
+	__sync_fetch_and_add(&on_cpus_done, 1);
+	/* there is nothing to return to, wait to be destroyed */
+	for (;;)
+		mb();
+}
+
+/*
+ * Call func(data) on the calling cpu and on all the cpus that aren't
+ * set up, and wait for it to return on all of them.  The other cpus
+ * are set up for the call, so func runs there without DAT, and are
+ * destroyed after it.  Cpus that are already set up are left alone.
+ */
+void on_cpus(void (*func)(void *data), void *data)
+{
+	struct psw psw = {
+		.mask = extract_psw_mask(),
+		.addr = (unsigned long)on_cpus_entry,
+	};
+	int i, nr = 0, num = smp_query_num_cpus();
+	uint16_t this_cpu = stap();
+	uint16_t *addrs;
+
+	addrs = calloc(num, sizeof(*addrs));
+	assert(addrs);
+
+	on_cpus_func = func;
+	on_cpus_data = data;
+	on_cpus_done = 0;
+	mb();
+
+	for (i = 0; i < num; i++) {
+		if (cpus[i].addr == this_cpu || cpus[i].active)
+			continue;
+		if (!smp_cpu_setup(cpus[i].addr, psw))
+			addrs[nr++] = cpus[i].addr;
+	}
+
+	func(data);
+
+	while (*(volatile int *)&on_cpus_done < nr)
+		mb();
+	for (i = 0; i < nr; i++)
+		smp_cpu_destroy(addrs[i]);
+	free(addrs);
+}
+
 /*
  * Disregarding state, stop all cpus that once were online except for
  * calling cpu.
@@ -225,7 +280,7 @@ void smp_teardown(void)
 extern uint64_t *stackptr;
 void smp_setup(void)
 {
-	int i = 0;
+	int i = 0, max_addr = 0;
 	unsigned short cpu0_addr = stap();
 	struct ReadCpuInfo *info = (void *)cpu_info_buffer;
 
@@ -247,6 +302,10 @@ void smp_setup(void)
 			cpu0->lowcore = (void *)0;
 			cpu0->active = true;
 		}
+		max_addr = MAX(max_addr, cpus[i].addr);
 	}
+
+	/* per-CPU areas are indexed by CPU address, like stap() */
+	percpu_init(max_addr + 1, cpu0_addr);
 	spin_unlock(&lock);
 }
@@ -47,6 +47,7 @@ int smp_cpu_stop(uint16_t addr);
 int smp_cpu_stop_store_status(uint16_t addr);
 int smp_cpu_destroy(uint16_t addr);
 int smp_cpu_setup(uint16_t addr, struct psw psw);
+void on_cpus(void (*func)(void *data), void *data);
 void smp_teardown(void);
 void smp_setup(void);
 
@@ -0,0 +1,76 @@
+/*
+ * s390x string functions
+ *
+ * Short clears use XC, everything else MOVE LONG, which moves a whole
+ * range, or fills it with a padding byte, in one interruptible
+ * instruction.  MVCL lengths are 24 bits wide, so larger ranges are
+ * done in chunks.
+ *
+ * This code is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Library General Public License version 2.
+ */
+#include <libcflat.h>
+
+#define MVCL_MAX	(1UL << 23)
+
+static void mvcl(void *dest, unsigned long dest_len, const void *src,
+		 unsigned long src_len, int pad)
+{
+	register unsigned long d asm("2") = (unsigned long)dest;
+	register unsigned long dl asm("3") = dest_len;
+	register unsigned long s asm("4") = (unsigned long)src;
+	register unsigned long sl asm("5") = (unsigned long)(u8)pad << 24 |
+					     src_len;
+
+	asm volatile("	mvcl	%[d],%[s]\n"
+		     : [d] "+a" (d), "+d" (dl), [s] "+a" (s), "+d" (sl)
+		     : : "cc", "memory");
+}
+
+/* Clear 1 to 256 bytes */
+static void xc(void *s, size_t n)
+{
+	asm volatile("	exrl	%1,0f\n"
+		     "	j	1f\n"
+		     "0:	xc	0(1,%0),0(%0)\n"
+		     "1:\n"
+		     : : "a" (s), "a" (n - 1) : "cc", "memory");
+}
+
+void *memset(void *s, int c, size_t n)
+{
+	void *p = s;
+	size_t len;
+
+	if (!c && n <= 256) {
+		if (n)
+			xc(s, n);
+		return s;
+	}
+
+	for (; n; p += len, n -= len) {
+		len = MIN(n, MVCL_MAX);
+		mvcl(p, len, NULL, 0, c);
+	}
+	return s;
+}
+
+void *memcpy(void *dest, const void *src, size_t n)
+{
+	void *d = dest;
+	size_t len;
+
+	for (; n; d += len, src += len, n -= len) {
+		len = MIN(n, MVCL_MAX);
+		mvcl(d, len, src, len, 0);
+	}
+	return dest;
+}
+
+void *memmove(void *dest, const void *src, size_t n)
+{
+	/* MVCL refuses, with cc 3, to move over a src that is still to be read */
+	if (dest <= src || dest >= src + n)
+		return memcpy(dest, src, n);
+	return generic_memmove(dest, src, n);
+}
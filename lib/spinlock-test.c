@@ -0,0 +1,125 @@
+/*
+ * Spinlock throughput and fairness harness
+ *
+ * This code is based on code from the tcg_baremetal_tests.
+ *
+ * Copyright (C) 2015 Virtual Open Systems SAS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include "libcflat.h"
+#include "bench.h"
+#include "spinlock-test.h"
+#include <asm/barrier.h>
+#include <asm/smp.h>
+
+static struct lock_ops *lock_ops;
+static int nr_running;
+static unsigned long nr_loops;
+
+static int global_a, global_b;
+static struct spinlock global_lock;
+static unsigned long global_count;
+static int ready;
+static unsigned long acquired[SPINLOCK_TEST_CPUS];
+static u64 elapsed[SPINLOCK_TEST_CPUS];
+
+static void test_spinlock(void *data __unused)
+{
+	unsigned long i, errors = 0;
+	u64 start;
+	int slot;
+
+	/*
+	 * The CPU numbers needn't be dense (they are APIC IDs on x86), so
+	 * each CPU takes a slot in the order it comes in.
+	 */
+	slot = __sync_fetch_and_add(&ready, 1);
+	while (*(volatile int *)&ready < nr_running)
+		cpu_relax();
+
+	/*
+	 * The CPUs share @nr_loops acquisitions per CPU between them, so
+	 * that an unfair lock shows in how many each of them got.
+	 */
+	start = bench_cycles();
+	for (i = 0;; i++) {
+		lock_ops->lock(&global_lock);
+
+		if (global_count >= nr_loops * nr_running) {
+			lock_ops->unlock(&global_lock);
+			break;
+		}
+		global_count++;
+
+		if (global_a == (slot + 1) % 2) {
+			global_a = 1;
+			global_b = 0;
+		} else {
+			global_a = 0;
+			global_b = 1;
+		}
+		if (global_a == global_b)
+			errors++;
+
+		lock_ops->unlock(&global_lock);
+	}
+	elapsed[slot] = bench_cycles() - start;
+	acquired[slot] = i;
+	report("CPU%d: Done - Errors: %ld", errors == 0,
+	       (int)smp_processor_id(), errors);
+}
+
+static void report_lock_perf(void)
+{
+	unsigned long total = 0, min = ~0ul, max = 0;
+	u64 cycles = 0, ns;
+	char metric[64];
+	int i;
+
+	for (i = 0; i < nr_running; i++) {
+		total += acquired[i];
+		min = MIN(min, acquired[i]);
+		max = MAX(max, acquired[i]);
+		cycles = MAX(cycles, elapsed[i]);
+	}
+	if (!total)
+		return;
+
+	ns = bench_cycles_to_ns(cycles);
+	if (ns)
+		report_perf(lock_ops->name, ns / total, "ns");
+	else
+		report_perf(lock_ops->name, cycles / total, "cycles");
+	snprintf(metric, sizeof(metric), "%s.fairness", lock_ops->name);
+	report_perf(metric, (u64)min * 1000 / max, "permille");
+}
+
+void run_spinlock_test(struct lock_ops *ops, int nr_cpus,
+		       unsigned long loops)
+{
+	report_prefix_push(ops->name);
+	if (nr_cpus > SPINLOCK_TEST_CPUS) {
+		report_skip("%d CPUs, at most %d supported",
+			    nr_cpus, SPINLOCK_TEST_CPUS);
+		report_prefix_pop();
+		return;
+	}
+
+	lock_ops = ops;
+	nr_running = nr_cpus;
+	nr_loops = loops;
+	global_a = global_b = 0;
+	global_lock.v = 0;
+	global_count = 0;
+	ready = 0;
+	memset(acquired, 0, sizeof(acquired));
+	memset(elapsed, 0, sizeof(elapsed));
+	smp_wmb();
+
+	on_cpus(test_spinlock, NULL);
+	report_lock_perf();
+	report_prefix_pop();
+}
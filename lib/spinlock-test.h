@@ -0,0 +1,36 @@
+/*
+ * Spinlock throughput and fairness harness, for arm/spinlock-test.c
+ * and x86/spinlock_test.c
+ *
+ * run_spinlock_test() has every CPU take and release a lock with the
+ * given ops until they have done @loops acquisitions per CPU between
+ * them, checking that the lock kept them out of each other's way.  It
+ * then reports the time per acquisition, and the fairness as the
+ * permille of acquisitions the least lucky CPU got compared to the
+ * luckiest one.
+ *
+ * It uses on_cpus(), so the CPUs must be brought up first, with
+ * smp_init() on x86.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef _SPINLOCK_TEST_H_
+#define _SPINLOCK_TEST_H_
+
+#include "libcflat.h"
+#include <asm/spinlock.h>
+
+#define SPINLOCK_TEST_CPUS	256
+
+struct lock_ops {
+	const char *name;
+	void (*lock)(struct spinlock *lock);
+	void (*unlock)(struct spinlock *lock);
+};
+
+extern void run_spinlock_test(struct lock_ops *ops, int nr_cpus,
+			      unsigned long loops);
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * The slow path of the MCS spinlock
+ *
+ * The lock word holds MCS_LOCKED in its low byte, and the tail of the
+ * queue of waiters above it, as the CPU and nesting level of the last
+ * waiter's node plus one.  Each CPU has a node per nesting level, as a
+ * waiter can be interrupted by a handler that waits for another lock.
+ *
+ * The waiter at the head of the queue spins on the lock word, all the
+ * others on their own node.  Once it has the lock, the head hands the
+ * queue over to the next waiter and is done with its node, so that
+ * spin_unlock() doesn't need it.
+ *
+ * CPUs past MCS_CPUS can't queue, so they wait for the queue to drain
+ * and take the lock like the fast path does.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#include "libcflat.h"
+#include <asm/spinlock.h>
+#include <asm/barrier.h>
+#include <asm/smp.h>
+
+#define MCS_CPUS	256
+#define MCS_NESTING	4
+#define MCS_TAIL_SHIFT	8
+
+struct mcs_node {
+	struct mcs_node *next;
+	int wait;
+	unsigned int nesting;	/* nodes in use, in the first node */
+} __attribute__((aligned(64)));
+
+static struct mcs_node mcs_nodes[MCS_CPUS][MCS_NESTING];
+
+static unsigned int mcs_tail(unsigned int cpu, unsigned int idx)
+{
+	return (cpu * MCS_NESTING + idx + 1) << MCS_TAIL_SHIFT;
+}
+
+static struct mcs_node *mcs_tail_node(unsigned int tail)
+{
+	tail = (tail >> MCS_TAIL_SHIFT) - 1;
+	return &mcs_nodes[tail / MCS_NESTING][tail % MCS_NESTING];
+}
+
+static void mcs_spin_lock_unqueued(struct spinlock *lock)
+{
+	while (!__sync_bool_compare_and_swap(&lock->v, 0, MCS_LOCKED))
+		cpu_relax();
+}
+
+void mcs_spin_lock_slow(struct spinlock *lock)
+{
+	unsigned int cpu = smp_processor_id();
+	struct mcs_node *node, *next;
+	unsigned int idx, tail, old, prev;
+
+	if (cpu >= MCS_CPUS || mcs_nodes[cpu][0].nesting == MCS_NESTING) {
+		mcs_spin_lock_unqueued(lock);
+		return;
+	}
+
+	idx = mcs_nodes[cpu][0].nesting++;
+	node = &mcs_nodes[cpu][idx];
+	node->next = NULL;
+	node->wait = 1;
+	tail = mcs_tail(cpu, idx);
+
+	/* queue up, behind the previous tail if any */
+	old = *(volatile unsigned int *)&lock->v;
+	while ((prev = __sync_val_compare_and_swap(&lock->v, old,
+					(old & MCS_LOCKED) | tail)) != old)
+		old = prev;
+
+	if (old >> MCS_TAIL_SHIFT) {
+		*(struct mcs_node * volatile *)&mcs_tail_node(old)->next = node;
+		while (*(volatile int *)&node->wait)
+			cpu_relax();
+	}
+
+	/* at the head of the queue, wait for the holder to go away */
+	for (;;) {
+		old = *(volatile unsigned int *)&lock->v;
+		if (old & MCS_LOCKED) {
+			cpu_relax();
+			continue;
+		}
+		/* the last waiter empties the queue as it takes the lock */
+		if ((old & ~MCS_LOCKED) == tail) {
+			if (__sync_bool_compare_and_swap(&lock->v, old, MCS_LOCKED))
+				goto out;
+		} else if (__sync_bool_compare_and_swap(&lock->v, old,
+							old | MCS_LOCKED)) {
+			break;
+		}
+	}
+
+	while (!(next = *(struct mcs_node * volatile *)&node->next))
+		cpu_relax();
+	__sync_synchronize();
+	*(volatile int *)&next->wait = 0;
+out:
+	mcs_nodes[cpu][0].nesting--;
+}
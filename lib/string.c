@@ -72,7 +72,12 @@ char *strstr(const char *s1, const char *s2)
     return NULL;
 }
 
-void *memset(void *s, int c, size_t n)
+/*
+ * The generic versions of the mem* functions are always built, so that
+ * they can be compared with the arch versions, which take over the
+ * standard names when asm/string.h defines HAVE_ARCH_<FUNCTION>.
+ */
+void *generic_memset(void *s, int c, size_t n)
 {
     size_t i;
     char *a = s;
@@ -83,7 +88,7 @@ void *memset(void *s, int c, size_t n)
     return s;
 }
 
-void *memcpy(void *dest, const void *src, size_t n)
+void *generic_memcpy(void *dest, const void *src, size_t n)
 {
     size_t i;
     char *a = dest;
@@ -95,7 +100,7 @@ void *memcpy(void *dest, const void *src, size_t n)
     return dest;
 }
 
-int memcmp(const void *s1, const void *s2, size_t n)
+int generic_memcmp(const void *s1, const void *s2, size_t n)
 {
     const unsigned char *a = s1, *b = s2;
     int ret = 0;
@@ -109,7 +114,7 @@ int memcmp(const void *s1, const void *s2, size_t n)
     return ret;
 }
 
-void *memmove(void *dest, const void *src, size_t n)
+void *generic_memmove(void *dest, const void *src, size_t n)
 {
     const unsigned char *s = src;
     unsigned char *d = dest;
@@ -125,6 +130,34 @@ void *memmove(void *dest, const void *src, size_t n)
     return dest;
 }
 
+#ifndef HAVE_ARCH_MEMSET
+void *memset(void *s, int c, size_t n)
+{
+    return generic_memset(s, c, n);
+}
+#endif
+
+#ifndef HAVE_ARCH_MEMCPY
+void *memcpy(void *dest, const void *src, size_t n)
+{
+    return generic_memcpy(dest, src, n);
+}
+#endif
+
+#ifndef HAVE_ARCH_MEMCMP
+int memcmp(const void *s1, const void *s2, size_t n)
+{
+    return generic_memcmp(s1, s2, n);
+}
+#endif
+
+#ifndef HAVE_ARCH_MEMMOVE
+void *memmove(void *dest, const void *src, size_t n)
+{
+    return generic_memmove(dest, src, n);
+}
+#endif
+
 void *memchr(const void *s, int c, size_t n)
 {
     const unsigned char *str = s, chr = (unsigned char)c;
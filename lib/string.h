@@ -7,6 +7,8 @@
 #ifndef __STRING_H
 #define __STRING_H
 
+#include <asm/string.h>
+
 extern unsigned long strlen(const char *buf);
 extern char *strcat(char *dest, const char *src);
 extern char *strcpy(char *dest, const char *src);
@@ -20,4 +22,9 @@ extern int memcmp(const void *s1, const void *s2, size_t n);
 extern void *memmove(void *dest, const void *src, size_t n);
 extern void *memchr(const void *s, int c, size_t n);
 
+extern void *generic_memset(void *s, int c, size_t n);
+extern void *generic_memcpy(void *dest, const void *src, size_t n);
+extern int generic_memcmp(const void *s1, const void *s2, size_t n);
+extern void *generic_memmove(void *dest, const void *src, size_t n);
+
 #endif /* _STRING_H */
@@ -13,17 +13,129 @@
 #include "alloc_phys.h"
 #include "alloc_page.h"
 #include "vmalloc.h"
+#include "bitops.h"
+
+/*
+ * Virtual addresses are handed out downwards from vfree_top.  Ranges that
+ * are given back are kept in free_ranges, sorted by address and merged
+ * with their neighbours, and are reused first-fit.  A free range that
+ * reaches vfree_top is returned to it.  Should the table ever fill up,
+ * further freed ranges are leaked, as everything was before.
+ *
+ * Ranges are kept as start and size rather than start and end, because
+ * the top of the address space, where x86_64 starts, wraps to zero.
+ */
+#define MAX_FREE_RANGES	256
+
+struct vrange {
+	uintptr_t start;
+	uintptr_t size;
+};
 
 static struct spinlock lock;
 static void *vfree_top = 0;
 static void *page_root;
+static struct vrange free_ranges[MAX_FREE_RANGES];
+static unsigned int nr_free_ranges;
+
+static void del_free_range(unsigned int i)
+{
+	nr_free_ranges--;
+	memmove(&free_ranges[i], &free_ranges[i + 1],
+		(nr_free_ranges - i) * sizeof(struct vrange));
+}
+
+/* Give [start, start + size) back, with the lock held. */
+static void __free_vpages(uintptr_t start, uintptr_t size)
+{
+	unsigned int i;
+
+	if (!size)
+		return;
+
+	for (i = 0; i < nr_free_ranges && free_ranges[i].start < start; i++)
+		;
+	assert_msg((i == 0 || free_ranges[i - 1].start +
+				free_ranges[i - 1].size <= start) &&
+		   (i == nr_free_ranges ||
+		    start + size <= free_ranges[i].start),
+		   "double free of %#lx + %#lx", start, size);
+
+	if (i > 0 && free_ranges[i - 1].start + free_ranges[i - 1].size == start) {
+		/* merge with the range below, and maybe the one above */
+		i--;
+		free_ranges[i].size += size;
+		if (i + 1 < nr_free_ranges &&
+		    start + size == free_ranges[i + 1].start) {
+			free_ranges[i].size += free_ranges[i + 1].size;
+			del_free_range(i + 1);
+		}
+	} else if (i < nr_free_ranges && start + size == free_ranges[i].start) {
+		free_ranges[i].start = start;
+		free_ranges[i].size += size;
+	} else if (nr_free_ranges < MAX_FREE_RANGES) {
+		memmove(&free_ranges[i + 1], &free_ranges[i],
+			(nr_free_ranges - i) * sizeof(struct vrange));
+		free_ranges[i].start = start;
+		free_ranges[i].size = size;
+		nr_free_ranges++;
+	} else {
+		return;
+	}
+
+	if (i == 0 && free_ranges[0].start == (uintptr_t)vfree_top) {
+		vfree_top += free_ranges[0].size;
+		del_free_range(0);
+	}
+}
+
+/*
+ * Allocates nr pages of address space, aligned to (1 << align_order)
+ * pages.  Whatever alignment leaves over on either side is given back.
+ */
+void *alloc_vpages_aligned(ulong nr, unsigned int align_order)
+{
+	uintptr_t size = PAGE_SIZE * nr, align = PAGE_SIZE << align_order;
+	uintptr_t start, top;
+	struct vrange r;
+	unsigned int i;
+
+	spin_lock(&lock);
+	for (i = 0; i < nr_free_ranges; i++) {
+		r = free_ranges[i];
+		if (r.size < size)
+			continue;
+		start = (r.start + r.size - size) & ~(align - 1);
+		if (start < r.start)
+			continue;
+		del_free_range(i);
+		__free_vpages(r.start, start - r.start);
+		__free_vpages(start + size, r.start + r.size - start - size);
+		spin_unlock(&lock);
+		return (void *)start;
+	}
+
+	top = (uintptr_t)vfree_top;
+	start = (top - size) & ~(align - 1);
+	vfree_top = (void *)start;
+	__free_vpages(start + size, top - start - size);
+	spin_unlock(&lock);
+	return (void *)start;
+}
 
 void *alloc_vpages(ulong nr)
 {
+	return alloc_vpages_aligned(nr, 0);
+}
+
+void free_vpages(void *mem, ulong nr)
+{
+	assert_msg((uintptr_t)mem % PAGE_SIZE == 0,
+		   "mem not page aligned: %p", mem);
+
 	spin_lock(&lock);
-	vfree_top -= PAGE_SIZE * nr;
+	__free_vpages((uintptr_t)mem, PAGE_SIZE * nr);
 	spin_unlock(&lock);
-	return vfree_top;
 }
 
 void *alloc_vpage(void)
@@ -33,51 +145,114 @@ void *alloc_vpage(void)
 
 void init_alloc_vpage(void *top)
 {
+	spin_lock(&lock);
 	vfree_top = top;
+	nr_free_ranges = 0;
+	spin_unlock(&lock);
+}
+
+/*
+ * Large allocations are backed by physically contiguous chunks of this
+ * order where possible, at addresses aligned to it, so that map_range()
+ * fills whole page tables at once or uses block mappings.
+ */
+#define VM_CHUNK_ORDER	9
+
+static unsigned int vm_align_order(unsigned long pages)
+{
+	return pages >= BIT(VM_CHUNK_ORDER) ? VM_CHUNK_ORDER : 0;
 }
 
 void *vmap(phys_addr_t phys, size_t size)
 {
-	void *mem, *p;
+	void *mem;
 	unsigned pages;
 
 	size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
 	pages = size / PAGE_SIZE;
-	mem = p = alloc_vpages(pages);
+	mem = alloc_vpages_aligned(pages, vm_align_order(pages));
 
 	phys &= ~(unsigned long long)(PAGE_SIZE - 1);
-	while (pages--) {
-		install_page(page_root, phys, p);
-		phys += PAGE_SIZE;
-		p += PAGE_SIZE;
-	}
+	map_range(page_root, mem, phys, size,
+		  MAP_WRITE | MAP_USER | MAP_BLOCKS);
 	return mem;
 }
 
 static void *vm_memalign(size_t alignment, size_t size)
 {
-	void *mem, *p;
-	unsigned pages;
+	void *mem, *p, *page;
+	unsigned long pages, order;
 
 	assert(alignment <= PAGE_SIZE);
 	size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
 	pages = size / PAGE_SIZE;
-	mem = p = alloc_vpages(pages);
-	while (pages--) {
-		phys_addr_t pa = virt_to_phys(alloc_page());
-		install_page(page_root, pa, p);
-		p += PAGE_SIZE;
+	mem = p = alloc_vpages_aligned(pages, vm_align_order(pages));
+	while (pages) {
+		order = MIN(fls(pages), VM_CHUNK_ORDER);
+		/* fall back to smaller chunks if memory is fragmented */
+		while (!(page = order ? alloc_pages(order) : alloc_page()) &&
+		       order)
+			order--;
+		assert_msg(page, "out of memory");
+		/*
+		 * No block mappings, as tests change the PTEs of malloc'd
+		 * memory a page at a time, with install_pte() and get_pte().
+		 */
+		map_range(page_root, p, virt_to_phys(page), PAGE_SIZE << order,
+			  MAP_WRITE | MAP_USER);
+		p += PAGE_SIZE << order;
+		pages -= BIT(order);
 	}
 	return mem;
 }
 
+/*
+ * The pages can only go back to the page allocator once no TLB maps
+ * them any more, so they are looked up, unmapped and then freed, a batch
+ * of VM_FREE_RUNS physically contiguous runs at a time.  If the TLBs of
+ * the other CPUs couldn't be flushed, another CPU may still write
+ * through a stale translation, so the pages of the batch are leaked and
+ * the virtual range isn't reused.
+ */
+#define VM_FREE_RUNS	16
+
 static void vm_free(void *mem, size_t size)
 {
-	while (size) {
-		free_page(phys_to_virt(virt_to_pte_phys(page_root, mem)));
-		mem += PAGE_SIZE;
-		size -= PAGE_SIZE;
+	struct {
+		phys_addr_t phys;
+		size_t len;
+	} runs[VM_FREE_RUNS];
+	size_t off = 0, start, i, nr;
+	bool flushed = true;
+	phys_addr_t phys;
+
+	while (off < size) {
+		start = off;
+		nr = 0;
+		for (; off < size; off += PAGE_SIZE) {
+			phys = virt_to_pte_phys(page_root, mem + off);
+			if (nr && runs[nr - 1].phys + runs[nr - 1].len == phys) {
+				runs[nr - 1].len += PAGE_SIZE;
+				continue;
+			}
+			if (nr == VM_FREE_RUNS)
+				break;
+			runs[nr].phys = phys;
+			runs[nr].len = PAGE_SIZE;
+			nr++;
+		}
+
+		if (!unmap_range(page_root, mem + start, off - start)) {
+			flushed = false;
+			continue;
+		}
+		for (i = 0; i < nr; i++)
+			for (start = 0; start < runs[i].len; start += PAGE_SIZE)
+				free_page(phys_to_virt(runs[i].phys + start));
 	}
+
+	if (flushed)
+		free_vpages(mem, size / PAGE_SIZE);
 }
 
 static struct alloc_ops vmalloc_ops = {
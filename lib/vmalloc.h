@@ -4,7 +4,9 @@
 #include <asm/page.h>
 
 extern void *alloc_vpages(ulong nr);
+extern void *alloc_vpages_aligned(ulong nr, unsigned int align_order);
 extern void *alloc_vpage(void);
+extern void free_vpages(void *mem, ulong nr);
 extern void init_alloc_vpage(void *top);
 extern void setup_vm(void);
 
@@ -12,6 +14,26 @@ extern void *setup_mmu(phys_addr_t top);
 extern phys_addr_t virt_to_pte_phys(pgd_t *pgtable, void *virt);
 extern pteval_t *install_page(pgd_t *pgtable, phys_addr_t phys, void *virt);
 
+/* Protection flags for map_range() */
+#define MAP_WRITE	(1u << 0)
+#define MAP_USER	(1u << 1)
+/* Allow 2M/1G (x86) or section (arm) leaves, where aligned */
+#define MAP_BLOCKS	(1u << 2)
+
+/*
+ * Map [virt, virt + len) to [phys, phys + len) with the given MAP_* flags,
+ * using block mappings where the addresses are aligned to them if
+ * MAP_BLOCKS is given.
+ */
+extern void map_range(pgd_t *pgtable, void *virt, phys_addr_t phys,
+		      size_t len, unsigned int prot);
+/*
+ * Clear the leaf entries of [virt, virt + len) and flush the TLB once.
+ * Returns false if the TLBs of other CPUs may still map the range, which
+ * can happen on x86 when other CPUs are busy in on_cpus() functions.
+ */
+extern bool unmap_range(pgd_t *pgtable, void *virt, size_t len);
+
 void *vmap(phys_addr_t phys, size_t size);
 
 #endif
@@ -0,0 +1,24 @@
+#ifndef _X86ASM_BENCH_H_
+#define _X86ASM_BENCH_H_
+
+#ifndef _BENCH_H_
+#error Do not directly include <asm/bench.h>. Just use <bench.h>.
+#endif
+
+#include "../processor.h"
+
+static inline u64 bench_cycles(void)
+{
+	return rdtsc();
+}
+
+/*
+ * The TSC rate isn't reliably enumerated to guests, so x86 results stay
+ * in TSC cycles.
+ */
+static inline u64 bench_cycles_hz(void)
+{
+	return 0;
+}
+
+#endif
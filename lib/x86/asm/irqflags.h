@@ -0,0 +1,23 @@
+#ifndef _X86ASM_IRQFLAGS_H_
+#define _X86ASM_IRQFLAGS_H_
+/*
+ * local_irq_save() disables interrupts on the calling CPU and returns
+ * the previous state, which local_irq_restore() puts back.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+
+static inline unsigned long local_irq_save(void)
+{
+	unsigned long flags;
+
+	asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+	return flags;
+}
+
+static inline void local_irq_restore(unsigned long flags)
+{
+	asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+#endif
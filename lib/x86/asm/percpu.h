@@ -0,0 +1,28 @@
+#ifndef _X86ASM_PERCPU_H_
+#define _X86ASM_PERCPU_H_
+
+#ifndef _PERCPU_H_
+#error Do not directly include <asm/percpu.h>. Just use <percpu.h>.
+#endif
+
+/*
+ * smp_init() keeps the per-CPU offset at %gs:8, after smp_id() at
+ * %gs:0 and the exception state at %gs:4-7.
+ */
+#define PERCPU_OFFSET_GS	8
+
+static inline unsigned long __my_cpu_offset(void)
+{
+	unsigned long offset;
+
+	asm volatile("mov %%gs:" xstr(PERCPU_OFFSET_GS) ", %0" : "=r"(offset));
+	return offset;
+}
+
+static inline void __set_my_cpu_offset(unsigned long offset)
+{
+	asm volatile("mov %0, %%gs:" xstr(PERCPU_OFFSET_GS)
+		     : : "r"(offset) : "memory");
+}
+
+#endif
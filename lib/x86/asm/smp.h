@@ -0,0 +1,9 @@
+#ifndef _ASMX86_SMP_H_
+#define _ASMX86_SMP_H_
+
+#include "../smp.h"
+
+/* The APIC ID, kept at %gs:0 by smp_init() */
+#define smp_processor_id()	smp_id()
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef _X86ASM_STRING_H_
+#define _X86ASM_STRING_H_
+
+#ifndef __STRING_H
+#error Do not directly include <asm/string.h>. Just use <string.h>.
+#endif
+
+#define HAVE_ARCH_MEMSET
+#define HAVE_ARCH_MEMCPY
+#define HAVE_ARCH_MEMMOVE
+
+#endif
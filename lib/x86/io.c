@@ -7,9 +7,17 @@
 #define USE_SERIAL
 #endif
 
+/*
+ * When QEMU has a debug console, each puts() goes there with one
+ * REP OUTSB, instead of costing two exits per character on the serial
+ * port.
+ */
+#define DEBUGCON_PORT		0xe9
+
 static struct spinlock lock;
 static int serial_iobase = 0x3f8;
 static int serial_inited = 0;
+static int debugcon = -1;
 
 static void serial_outb(char ch)
 {
@@ -58,11 +66,20 @@ static void serial_init(void)
         outb(0x03, serial_iobase + 0x04);
 }
 
-static void print_serial(const char *buf)
+static void print_serial(const char *buf, unsigned long len)
 {
-	unsigned long len = strlen(buf);
 #ifdef USE_SERIAL
         unsigned long i;
+
+        /* the debug console reads back 0xe9 */
+        if (debugcon < 0)
+            debugcon = inb(DEBUGCON_PORT) == DEBUGCON_PORT;
+        if (debugcon) {
+            asm volatile ("rep/outsb" : "+S"(buf), "+c"(len)
+                          : "d"(DEBUGCON_PORT) : "memory");
+            return;
+        }
+
         if (!serial_inited) {
             serial_init();
             serial_inited = 1;
@@ -72,14 +89,15 @@ static void print_serial(const char *buf)
             serial_put(buf[i]);
         }
 #else
-        asm volatile ("rep/outsb" : "+S"(buf), "+c"(len) : "d"(0xf1));
+        asm volatile ("rep/outsb" : "+S"(buf), "+c"(len) : "d"(0xf1)
+                      : "memory");
 #endif
 }
 
 void puts(const char *s)
 {
 	spin_lock(&lock);
-	print_serial(s);
+	print_serial(s, strlen(s));
 	spin_unlock(&lock);
 }
 
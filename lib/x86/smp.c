@@ -6,6 +6,7 @@
 #include "apic.h"
 #include "fwcfg.h"
 #include "desc.h"
+#include "percpu.h"
 
 #define IPI_VECTOR 0x20
 
@@ -63,6 +64,7 @@ int smp_id(void)
 static void setup_smp_id(void *data)
 {
     asm ("mov %0, %%gs:0" : : "r"(apic_id()) : "memory");
+    __set_my_cpu_offset(per_cpu_offset(apic_id()));
 }
 
 static void __on_cpu(int cpu, void (*function)(void *data), void *data,
@@ -115,7 +117,7 @@ int cpus_active(void)
 
 void smp_init(void)
 {
-    int i;
+    int i, max_id = 0;
     void ipi_entry(void);
 
     _cpu_count = fwcfg_get_nb_cpus();
@@ -124,6 +126,11 @@ void smp_init(void)
     init_apic_map();
     set_idt_entry(IPI_VECTOR, ipi_entry, 0);
 
+    /* per-CPU areas are indexed by APIC ID, like smp_id() */
+    for (i = 0; i < cpu_count(); ++i)
+        max_id = MAX(max_id, id_map[i]);
+    percpu_init(max_id + 1, apic_id());
+
     setup_smp_id(0);
     for (i = 1; i < cpu_count(); ++i)
         on_cpu(i, setup_smp_id, 0);
@@ -0,0 +1,59 @@
+/*
+ * x86 string functions
+ *
+ * REP STOSB/MOVSB are correct on every CPU and, with enhanced REP
+ * MOVSB/STOSB (ERMS), as fast as anything that could be written by hand
+ * for the sizes the tests use, while staying tiny.  Overlapping moves
+ * that need a backward copy are rare, and are done by hand.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#include "libcflat.h"
+
+void *memset(void *s, int c, size_t n)
+{
+	void *d = s;
+
+	asm volatile("rep stosb"
+		     : "+D" (d), "+c" (n)
+		     : "a" (c)
+		     : "memory");
+	return s;
+}
+
+void *memcpy(void *dest, const void *src, size_t n)
+{
+	void *d = dest;
+
+	asm volatile("rep movsb"
+		     : "+D" (d), "+S" (src), "+c" (n)
+		     : : "memory");
+	return dest;
+}
+
+void *memmove(void *dest, const void *src, size_t n)
+{
+	typedef unsigned long __attribute__((may_alias, aligned(1))) ulong_u;
+	char *d;
+	const char *s;
+
+	/* a forward copy is fine unless dest overlaps the end of src */
+	if (dest <= src || dest >= src + n)
+		return memcpy(dest, src, n);
+
+	/*
+	 * Copy backwards with plain moves rather than STD; REP MOVSB: an
+	 * interrupt or exception taken meanwhile would run its handler with
+	 * DF set, as the entry code doesn't clear it.
+	 */
+	d = dest + n;
+	s = src + n;
+	for (; n >= sizeof(long); n -= sizeof(long)) {
+		d -= sizeof(long);
+		s -= sizeof(long);
+		*(ulong_u *)d = *(const ulong_u *)s;
+	}
+	while (n--)
+		*--d = *--s;
+	return dest;
+}
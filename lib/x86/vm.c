@@ -2,6 +2,7 @@
 #include "libcflat.h"
 #include "vmalloc.h"
 #include "alloc_page.h"
+#include "smp.h"
 
 pteval_t *install_pte(pgd_t *cr3,
 		      int pte_level,
@@ -114,6 +115,123 @@ void install_pages(pgd_t *cr3, phys_addr_t phys, size_t len, void *virt)
 	}
 }
 
+/*
+ * Map a range one page table at a time: walk down to the table that
+ * holds the leaf entries for virt, fill as many of them as fit, and only
+ * then walk again.  With MAP_BLOCKS, the leaves are 2M/4M and 1G pages
+ * wherever virt and phys are aligned to them and no page table is in the
+ * way.
+ */
+void map_range(pgd_t *cr3, void *virt, phys_addr_t phys, size_t len,
+	       unsigned int prot)
+{
+	uintptr_t va = (uintptr_t)virt;
+	pteval_t flags = PT_PRESENT_MASK, *pt, *new_pt;
+	unsigned offset;
+	int level, max_level;
+	u64 size;
+
+	assert(va % PAGE_SIZE == 0);
+	assert(phys % PAGE_SIZE == 0);
+	assert(len % PAGE_SIZE == 0);
+
+	if (prot & MAP_WRITE)
+		flags |= PT_WRITABLE_MASK;
+	if (prot & MAP_USER)
+		flags |= PT_USER_MASK;
+
+	max_level = prot & MAP_BLOCKS ? 2 : 1;
+#ifdef __x86_64__
+	if ((prot & MAP_BLOCKS) && this_cpu_has(X86_FEATURE_GBPAGES))
+		max_level = 3;
+#endif
+
+	while (len) {
+		pt = cr3;
+		for (level = PAGE_LEVEL; level > 1; level--) {
+			offset = PGDIR_OFFSET(va, level);
+			size = 1ull << PGDIR_BITS(level);
+			if (!(pt[offset] & PT_PRESENT_MASK) &&
+			    (va | phys) % size == 0 && len >= size &&
+			    level <= max_level)
+				break;
+			if (!(pt[offset] & PT_PRESENT_MASK)) {
+				new_pt = alloc_page();
+				pt[offset] = virt_to_phys(new_pt) | PT_PRESENT_MASK |
+					     PT_WRITABLE_MASK | PT_USER_MASK;
+			}
+			assert_msg(!(pt[offset] & PT_PAGE_SIZE_MASK),
+				   "%p is mapped by a large page", (void *)va);
+			pt = phys_to_virt(pt[offset] & PT_ADDR_MASK);
+		}
+
+		offset = PGDIR_OFFSET(va, level);
+		size = 1ull << PGDIR_BITS(level);
+		do {
+			pt[offset] = phys | flags;
+			if (level > 1)
+				pt[offset] |= PT_PAGE_SIZE_MASK;
+			va += size;
+			phys += size;
+			len -= size;
+		} while (++offset <= PGDIR_MASK && len >= size &&
+			 (level == 1 || !(pt[offset] & PT_PRESENT_MASK)));
+	}
+}
+
+/*
+ * Beyond this many leaf entries, flushing the whole TLB is cheaper than
+ * one INVLPG per entry.
+ */
+#define UNMAP_INVLPG_MAX	32
+
+static void unmap_flush_tlb(void *data)
+{
+	flush_tlb();
+}
+
+/*
+ * The other CPUs may have the range in their TLBs too.  They are sent
+ * an IPI to flush them, but only when they are idle: on_cpus() functions
+ * run with interrupts disabled, so a CPU that is running one, the
+ * calling one included, wouldn't take it.
+ */
+bool unmap_range(pgd_t *cr3, void *virt, size_t len)
+{
+	struct pte_search search;
+	size_t off, size;
+	unsigned long nr_leaves = 0;
+	void *va;
+
+	assert((uintptr_t) virt % PAGE_SIZE == 0);
+	assert(len % PAGE_SIZE == 0);
+
+	for (off = 0; off < len; off += size) {
+		va = virt + off;
+		search = find_pte_level(cr3, va, 1);
+		size = 1ul << PGDIR_BITS(search.level);
+		if (!found_leaf_pte(search) || !(*search.pte & PT_PRESENT_MASK)) {
+			size = PAGE_SIZE;
+			continue;
+		}
+		assert_msg((uintptr_t)va % size == 0 && off + size <= len,
+			   "%p + %#lx splits a large page", virt, len);
+		*search.pte = 0;
+		if (++nr_leaves <= UNMAP_INVLPG_MAX)
+			invlpg(va);
+	}
+
+	if (nr_leaves > UNMAP_INVLPG_MAX)
+		flush_tlb();
+
+	if (cpu_count() <= 1)
+		return true;
+	if (cpus_active() > 1)
+		return false;
+	on_cpus(unmap_flush_tlb, NULL);
+	return true;
+}
+
 bool any_present_pages(pgd_t *cr3, void *virt, size_t len)
 {
 	uintptr_t max = (uintptr_t) virt + len;
@@ -175,7 +293,10 @@ void *setup_mmu(phys_addr_t end_of_memory)
 
 phys_addr_t virt_to_pte_phys(pgd_t *cr3, void *mem)
 {
-    return (*get_pte(cr3, mem) & PT_ADDR_MASK) + ((ulong)mem & (PAGE_SIZE - 1));
+    struct pte_search search = find_pte_level(cr3, mem, 1);
+    u64 mask = (1ull << PGDIR_BITS(search.level)) - 1;
+
+    return (*search.pte & PT_ADDR_MASK & ~mask) + ((ulong)mem & mask);
 }
 
 /*
@@ -0,0 +1,82 @@
+/*
+ * Dirty guest memory while the VM is being migrated
+ *
+ * This is the guest side of the migration performance mode of the
+ * runner (run_tests.sh --migration-perf).  It keeps writing to every
+ * page of a buffer, so that migration has to send pages again and
+ * again, until the key press that follows the end of migration.
+ *
+ * Each pass also checks that the pages still hold what the pass before
+ * wrote.  Wherever migration stops the VM, the first pass that runs on
+ * the destination then finds any page whose last write on the source
+ * didn't make it over.
+ *
+ * Options:
+ *   -m <MB>     size of the dirtied buffer (default 64)
+ *   -s <pages>  only dirty one page out of <pages> (default 1)
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#include <libcflat.h>
+#include <alloc.h>
+#include <asm/page.h>
+
+#define DIRTY_PAGE_SIZE	4096
+
+static unsigned long nr_pages, stride = 1;
+static u64 *buf;
+
+/* Returns the number of pages that didn't hold the previous pass */
+static unsigned long dirty_pass(u64 pass)
+{
+	unsigned long i, bad = 0;
+	u64 *p;
+
+	for (i = 0; i < nr_pages; i += stride) {
+		p = &buf[i * DIRTY_PAGE_SIZE / sizeof(u64)];
+		if (pass > 1 && *p != pass - 1)
+			++bad;
+		*p = pass;
+	}
+	return bad;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long mb = 64, bad = 0;
+	u64 pass = 0;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+			mb = atol(argv[++i]);
+		} else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+			stride = atol(argv[++i]);
+		} else {
+			report_abort("Warning: Unsupported argument: %s",
+				     argv[i]);
+		}
+	}
+
+	if (!mb || !stride)
+		report_abort("Error: -m and -s need a non-zero value");
+
+	nr_pages = mb * 1024 * 1024 / DIRTY_PAGE_SIZE;
+	buf = memalign(DIRTY_PAGE_SIZE, nr_pages * DIRTY_PAGE_SIZE);
+	if (!buf)
+		report_abort("Error: cannot allocate %lu MB", mb);
+
+	report_prefix_push("migrate-dirty");
+	report_info("dirtying %lu pages of %lu MB", nr_pages / stride, mb);
+
+	dirty_pass(++pass);
+	puts("Now migrate the VM, then press a key to continue...\n");
+	while (__getchar() == -1)
+		bad += dirty_pass(++pass);
+
+	report_info("%" PRIu64 " dirty passes", pass);
+	report("%lu stale pages", bad == 0, bad);
+
+	report_prefix_pop();
+	return report_summary();
+}
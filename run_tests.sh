@@ -2,6 +2,14 @@
 
 verbose="no"
 tap_output="no"
+json_output="no"
+junit_output="no"
+repeat=1
+kvmstat="no"
+baseline=""
+threshold=10
+shard=""
+durations=""
 run_all_tests="no" # don't run nodefault tests
 
 if [ ! -f config.mak ]; then
@@ -15,15 +23,62 @@ function usage()
 {
 cat <<EOF
 
-Usage: $0 [-h] [-v] [-a] [-g group] [-j NUM-TASKS] [-t]
+Usage: $0 [-h] [-v] [-a] [-g group] [-j NUM-TASKS] [-t] [--json] [--junit]
+          [-r NUM] [--baseline FILE [--threshold PERCENT]] [--pin CPULIST]
+          [--cache DIR] [--kvmstat] [--migration-perf]
+          [--shard I/N [--durations FILE]]
 
     -h, --help      Output this help text
-    -v, --verbose   Enables verbose mode
+    -v, --verbose   Enables verbose mode, in which the tests log every
+                    result instead of only their failures and per-prefix
+                    totals
     -a, --all       Run all tests, including those flagged as 'nodefault'
                     and those guarded by errata.
     -g, --group     Only execute tests in the given group
     -j, --parallel  Execute tests in parallel
     -t, --tap13     Output test results in TAP format
+        --json      Record per-test status, timing and PERF metrics
+                    in logs/results.json
+        --junit     Record per-test results in JUnit XML format in
+                    logs/results.xml
+    -r, --repeat    Run each selected test NUM times in a row
+        --baseline  Compare PERF metrics with the results.json in FILE,
+                    and fail on significant regressions.  FILE is
+                    created from this run if it does not exist.
+                    Implies --json
+        --threshold Regression threshold in percent for --baseline
+                    (default $threshold)
+        --pin       Pin the QEMU I/O thread and each vCPU thread to
+                    dedicated host CPUs from CPULIST (e.g. 2-5), before
+                    the guest starts running.  CPULIST needs one more
+                    CPU than the test has vCPUs.  Can't be used with -j
+        --cache     Remember the tests that passed or skipped in DIR, and
+                    don't run them again until their kernel, their
+                    unittests.cfg entry, QEMU, the host kernel or the
+                    errata change
+        --kvmstat   Record the KVM exits of each test with "perf kvm stat"
+                    into logs/<test>.kvmstat, and summarize them in
+                    logs/results.json
+        --migration-perf
+                    Sample the progress of the migration of tests in the
+                    'migration' group, and report its total time,
+                    downtime, transferred bytes and dirty-sync count as
+                    PERF metrics.  MIGRATION_BANDWIDTH (MiB/s) and
+                    MIGRATION_DOWNTIME (ms) set the migration limits,
+                    MIGRATION_SAMPLE_INTERVAL (s, default 0.05) the
+                    sampling period
+        --shard     Only run shard I out of N of the tests.  Shards are
+                    balanced by the wall time of their tests, as
+                    recorded in the results.json given with --durations,
+                    and every shard computes the same partition.
+                    Implies --json.  scripts/merge_shards.py combines
+                    the logs of all shards
+        --durations The results.json of a previous run, used to balance
+                    --shard
+
+A performance regression suite is run with, e.g.
+
+    ./run_tests.sh -g vmexit -r 10 --pin 2-4 --baseline vmexit-baseline.json
 
 Set the environment variable QEMU=/path/to/qemu-system-ARCH to
 specify the appropriate qemu binary for ARCH-run.
@@ -35,7 +90,7 @@ RUNTIME_arch_run="./$TEST_DIR/run"
 source scripts/runtime.bash
 
 only_tests=""
-args=`getopt -u -o ag:htj:v -l all,group:,help,tap13,parallel:,verbose -- $*`
+args=`getopt -u -o ag:htj:r:v -l all,group:,help,tap13,parallel:,verbose,json,junit,repeat:,baseline:,threshold:,pin:,cache:,kvmstat,migration-perf,shard:,durations: -- $*`
 [ $? -ne 0 ] && exit 2;
 set -- $args;
 while [ $# -gt 0 ]; do
@@ -66,6 +121,57 @@ while [ $# -gt 0 ]; do
         -t | --tap13)
             tap_output="yes"
             ;;
+        --json)
+            json_output="yes"
+            ;;
+        --junit)
+            junit_output="yes"
+            ;;
+        -r | --repeat)
+            shift
+            repeat=$1
+            if (( $repeat <= 0 )); then
+                echo "Invalid -r option: $repeat"
+                exit 2
+            fi
+            ;;
+        --baseline)
+            shift
+            baseline=$1
+            json_output="yes"
+            ;;
+        --threshold)
+            shift
+            threshold=$1
+            ;;
+        --pin)
+            shift
+            export PIN_CPUS=$1
+            ;;
+        --cache)
+            shift
+            RUNTIME_cache_dir=$1
+            ;;
+        --kvmstat)
+            kvmstat="yes"
+            ;;
+        --migration-perf)
+            export MIGRATION_PERF=yes
+            ;;
+        --shard)
+            shift
+            shard=$1
+            if ! [[ $shard =~ ^([0-9]+)/([0-9]+)$ ]] ||
+               (( ${BASH_REMATCH[1]} < 1 || ${BASH_REMATCH[1]} > ${BASH_REMATCH[2]} )); then
+                echo "Invalid --shard option: $shard"
+                exit 2
+            fi
+            json_output="yes"
+            ;;
+        --durations)
+            shift
+            durations=$1
+            ;;
         --)
             ;;
         *)
@@ -75,6 +181,35 @@ while [ $# -gt 0 ]; do
     shift
 done
 
+if [ "$PIN_CPUS" ] && (( ${unittest_run_queues:-1} > 1 )); then
+    echo "--pin can't be used with -j"
+    exit 2
+fi
+
+# Unless asked for everything, the tests only log their failures and then
+# the totals of each prefix.  REPORT_QUIET=0 in the environment overrides
+# it, and the TAP output needs each result.
+if [ "$verbose" != "yes" ] && [ "$tap_output" = "no" ]; then
+    export REPORT_QUIET=${REPORT_QUIET:-1}
+fi
+
+if [ "$RUNTIME_cache_dir" ]; then
+    if (( $repeat > 1 )) || [ "$baseline" ]; then
+        echo "--cache can't be used with --repeat or --baseline"
+        exit 2
+    fi
+    mkdir -p "$RUNTIME_cache_dir" || exit 2
+    RUNTIME_cache_env=$(
+        source scripts/arch-run.bash
+        qemu=$(search_qemu_binary 2>/dev/null) && sha256sum < "$qemu"
+        uname -r
+        env | grep '^ERRATA_' | sort
+        cat "$ERRATATXT" "$KVM_UNIT_TESTS_ENV" 2>/dev/null
+        cat "$RUNTIME_arch_run" scripts/arch-run.bash
+        echo "$MAX_SMP"
+    )
+fi
+
 # RUNTIME_log_file will be configured later
 if [[ $tap_output == "no" ]]; then
     process_test_output() { cat >> $RUNTIME_log_file; }
@@ -129,6 +264,9 @@ function run_task()
 	if [ -z "$testname" ]; then
 		return
 	fi
+	if [ "$shard" ] && [[ $shard_tests != *" $testname "* ]]; then
+		return
+	fi
 
 	while (( $(jobs | wc -l) == $unittest_run_queues )); do
 		# wait for any background test to finish
@@ -137,22 +275,58 @@ function run_task()
 
 	RUNTIME_log_file="${unittest_log_dir}/${testname}.log"
 	if [ $unittest_run_queues = 1 ]; then
-		run "$@"
+		run_repeat "$@"
 	else
-		run "$@" &
+		run_repeat "$@" &
 	fi
 }
 
+function run_repeat()
+{
+	local ret
+
+	for (( RUNTIME_iteration = 1; RUNTIME_iteration <= repeat; RUNTIME_iteration++ )); do
+		run "$@"
+		ret=$?
+		# Don't repeat tests that were filtered out or skipped, only
+		# tests that started QEMU have a log.
+		[ -f "$RUNTIME_log_file" ] || break
+		[ $ret -eq 2 ] || [ $ret -eq 77 ] && break
+	done
+	return $ret
+}
+
 : ${unittest_log_dir:=logs}
 : ${unittest_run_queues:=1}
 config=$TEST_DIR/unittests.cfg
 
+if [ "$durations" ] && [ ! -f "$durations" ]; then
+    echo "--durations: $durations not found"
+    exit 2
+fi
+if [ "$shard" ]; then
+    shard_tests=" $(shard_unittests $config ${shard%/*} ${shard#*/} "$durations" | tr '\n' ' ') "
+fi
+
 rm -rf $unittest_log_dir.old
 [ -d $unittest_log_dir ] && mv $unittest_log_dir $unittest_log_dir.old
 mkdir $unittest_log_dir || exit 2
 
+if [[ $kvmstat == "yes" ]]; then
+    export KVMSTAT_DIR=$unittest_log_dir
+fi
+
 echo "BUILD_HEAD=$(cat build-head)" > $unittest_log_dir/SUMMARY
 
+if [[ $json_output == "yes" ]] || [[ $junit_output == "yes" ]]; then
+    export RUNTIME_results_file="$unittest_log_dir/results.records"
+    : > $RUNTIME_results_file
+fi
+if [[ $junit_output == "yes" ]]; then
+    export RUNTIME_junit_file="$unittest_log_dir/results.testcases"
+    : > $RUNTIME_junit_file
+fi
+
 if [[ $tap_output == "yes" ]]; then
     echo "TAP version 13"
 fi
@@ -168,3 +342,39 @@ trap "wait; exit 130" SIGINT
 
 # wait until all tasks finish
 wait
+
+if [[ $json_output == "yes" ]]; then
+    {
+        echo "{ \"build_head\": \"$(cat build-head)\", \"arch\": \"$ARCH\","
+        [ "$shard" ] && echo "  \"shard\": \"$shard\","
+        echo "  \"tests\": ["
+        sed 's/^/    /;$!s/$/,/' $RUNTIME_results_file
+        echo "  ]"
+        echo "}"
+    } > $unittest_log_dir/results.json
+fi
+if [[ $junit_output == "yes" ]]; then
+    {
+        echo '<?xml version="1.0" encoding="UTF-8"?>'
+        echo "<testsuites>"
+        echo "<testsuite name=\"kvm-unit-tests\"" \
+             "tests=\"$(grep -c '^<testcase' $RUNTIME_junit_file)\"" \
+             "failures=\"$(grep -c '<failure' $RUNTIME_junit_file)\"" \
+             "skipped=\"$(grep -c '<skipped' $RUNTIME_junit_file)\">"
+        cat $RUNTIME_junit_file
+        echo "</testsuite>"
+        echo "</testsuites>"
+    } > $unittest_log_dir/results.xml
+    rm -f $RUNTIME_junit_file
+fi
+rm -f $RUNTIME_results_file
+
+if [ "$baseline" ]; then
+    if [ -f "$baseline" ]; then
+        ./scripts/perf_compare.py --threshold "$threshold" \
+            "$baseline" $unittest_log_dir/results.json || exit 1
+    else
+        cp $unittest_log_dir/results.json "$baseline"
+        echo "Saved performance baseline to $baseline"
+    fi
+fi
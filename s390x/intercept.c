@@ -10,6 +10,7 @@
  * under the terms of the GNU Library General Public License version 2.
  */
 #include <libcflat.h>
+#include <bench.h>
 #include <asm/asm-offsets.h>
 #include <asm/interrupt.h>
 #include <asm/page.h>
@@ -159,27 +160,70 @@ static void test_testblock(void)
 	check_pgm_int_code(PGM_INT_CODE_ADDRESSING);
 }
 
-static uint64_t get_clock_ms(void)
+/*
+ * The intercepted instructions alone, for timing: the checks above
+ * would otherwise be timed too, console output included.
+ */
+static void bench_stpx(void *data, u64 iters)
+{
+	uint32_t prefix;
+
+	while (iters--)
+		asm volatile(" stpx %0" : "=Q"(prefix));
+}
+
+static void bench_spx(void *data, u64 iters)
 {
-	uint64_t clk;
+	uint32_t prefix;
+
+	/* set the prefix to what it already is */
+	asm volatile(" stpx %0" : "=Q"(prefix));
+	while (iters--)
+		asm volatile(" spx %0" : : "Q"(prefix) : "memory");
+}
 
-	asm volatile(" stck %0 " : : "Q"(clk) : "memory");
+static void bench_stap(void *data, u64 iters)
+{
+	uint16_t cpuid;
 
-	/* Bit 51 is incrememented each microsecond */
-	return (clk >> (63 - 51)) / 1000;
+	while (iters--)
+		asm volatile("stap %0\n" : "=Q"(cpuid));
+}
+
+static void bench_stidp(void *data, u64 iters)
+{
+	struct cpuid id;
+
+	while (iters--)
+		asm volatile("stidp %0\n" : "=Q"(id));
+}
+
+static void bench_testblock(void *data, u64 iters)
+{
+	while (iters--)
+		asm volatile (
+			" lghi	%%r0,0\n"
+			" .insn	rre,0xb22c0000,0,%0\n"
+			: : "a"(pagebuf) : "memory", "0", "cc");
+}
+
+static uint64_t get_clock_ms(void)
+{
+	return bench_cycles_to_ns(bench_cycles()) / 1000000;
 }
 
 struct {
 	const char *name;
 	void (*func)(void);
+	bench_fn bench_fn;
 	bool run_it;
 } tests[] = {
-	{ "stpx", test_stpx, false },
-	{ "spx", test_spx, false },
-	{ "stap", test_stap, false },
-	{ "stidp", test_stidp, false },
-	{ "testblock", test_testblock, false },
-	{ NULL, NULL, false }
+	{ "stpx", test_stpx, bench_stpx, false },
+	{ "spx", test_spx, bench_spx, false },
+	{ "stap", test_stap, bench_stap, false },
+	{ "stidp", test_stidp, bench_stidp, false },
+	{ "testblock", test_testblock, bench_testblock, false },
+	{ NULL, NULL, NULL, false }
 };
 
 static void parse_intercept_test_args(int argc, char **argv)
@@ -218,6 +262,7 @@ static void parse_intercept_test_args(int argc, char **argv)
 
 int main(int argc, char **argv)
 {
+	struct bench b;
 	uint64_t startclk;
 	int ti;
 
@@ -249,5 +294,12 @@ int main(int argc, char **argv)
 
 	report_prefix_pop();
 
+	for (ti = 0; tests[ti].name != NULL; ti++) {
+		if (!tests[ti].run_it)
+			continue;
+		bench_run(&b, tests[ti].bench_fn, NULL);
+		bench_report(tests[ti].name, &b);
+	}
+
 	return report_summary();
 }
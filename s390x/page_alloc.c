@@ -0,0 +1 @@
+../x86/page_alloc.c
\ No newline at end of file
@@ -104,6 +104,67 @@ qmp ()
 	echo '{ "execute": "qmp_capabilities" }{ "execute":' "$2" '}' | nc -U $1
 }
 
+# Print the numeric value of a query-migrate field, e.g. "transferred"
+migration_field ()
+{
+	grep -o "\"$2\": [0-9]*" <<<"$1" | head -1 | awk '{print $2}'
+}
+
+# Migration performance mode (MIGRATION_PERF=yes): limit the bandwidth
+# to $MIGRATION_BANDWIDTH MiB/s and the expected downtime to
+# $MIGRATION_DOWNTIME ms, when set, before migration starts
+migration_set_limits ()
+{
+	local params=""
+
+	if [ "$MIGRATION_BANDWIDTH" ]; then
+		params+='"max-bandwidth": '$((MIGRATION_BANDWIDTH * 1024 * 1024))
+	fi
+	if [ "$MIGRATION_DOWNTIME" ]; then
+		params+=${params:+, }'"downtime-limit": '$MIGRATION_DOWNTIME
+	fi
+	[ -z "$params" ] && return 0
+
+	if qmp $1 '"migrate-set-parameters", "arguments": { '"$params"' }' |
+			grep -q '"error"'; then
+		echo "ERROR: cannot set migration parameters: $params" >&2
+		return 1
+	fi
+}
+
+# One line per query-migrate sample, so that the progress of the
+# migration can be plotted from the test log; $2 is the start time in ns
+migration_sample ()
+{
+	local ram=`grep -o '"ram": {[^}]*}' <<<"$1"`
+
+	echo "MIGRATION: t=$(( ($(date +%s%N) - $2) / 1000000 ))ms" \
+		"status=$(grep -o '"status": "[a-z-]*"' <<<"$1" | head -1 | cut -d'"' -f4)" \
+		"transferred=$(migration_field "$ram" transferred)" \
+		"remaining=$(migration_field "$ram" remaining)" \
+		"dirty-pages-rate=$(migration_field "$ram" dirty-pages-rate)" \
+		"dirty-sync-count=$(migration_field "$ram" dirty-sync-count)"
+}
+
+# Print the statistics of a completed migration as PERF lines
+migration_report ()
+{
+	local ram=`grep -o '"ram": {[^}]*}' <<<"$1"`
+	local value
+
+	value=`migration_field "$1" total-time`
+	[ "$value" ] && echo "PERF: migration_total_time $value ms"
+	value=`migration_field "$1" downtime`
+	[ "$value" ] && echo "PERF: migration_downtime $value ms"
+	value=`migration_field "$1" setup-time`
+	[ "$value" ] && echo "PERF: migration_setup_time $value ms"
+	value=`migration_field "$ram" transferred`
+	[ "$value" ] && echo "PERF: migration_transferred $value bytes"
+	value=`migration_field "$ram" dirty-sync-count`
+	[ "$value" ] && echo "PERF: migration_dirty_sync_count $value count"
+	return 0
+}
+
 run_migration ()
 {
 	if ! command -v nc >/dev/null 2>&1; then
@@ -138,13 +199,28 @@ run_migration ()
 		sleep 1
 	done
 
+	if [ "$MIGRATION_PERF" = "yes" ]; then
+		if ! migration_set_limits ${qmp1}; then
+			qmp ${qmp1} '"quit"'> ${qmpout1} 2>/dev/null
+			qmp ${qmp2} '"quit"'> ${qmpout2} 2>/dev/null
+			return 2
+		fi
+		interval=${MIGRATION_SAMPLE_INTERVAL:-0.05}
+	else
+		interval=1
+	fi
+
+	migstart=`date +%s%N`
 	qmp ${qmp1} '"migrate", "arguments": { "uri": "unix:'${migsock}'" }' > ${qmpout1}
 
 	# Wait for the migration to complete
 	migstatus=`qmp ${qmp1} '"query-migrate"' | grep return`
 	while ! grep -q '"completed"' <<<"$migstatus" ; do
-		sleep 1
+		sleep $interval
 		migstatus=`qmp ${qmp1} '"query-migrate"' | grep return`
+		if [ "$MIGRATION_PERF" = "yes" ]; then
+			migration_sample "$migstatus" $migstart
+		fi
 		if grep -q '"failed"' <<<"$migstatus" ; then
 			echo "ERROR: Migration failed." >&2
 			qmp ${qmp1} '"quit"'> ${qmpout1} 2>/dev/null
@@ -152,6 +228,9 @@ run_migration ()
 			return 2
 		fi
 	done
+	if [ "$MIGRATION_PERF" = "yes" ]; then
+		migration_report "$migstatus"
+	fi
 	qmp ${qmp1} '"quit"'> ${qmpout1} 2>/dev/null
 	echo > ${fifo}
 	wait $incoming_pid
@@ -167,6 +246,141 @@ migration_cmd ()
 	fi
 }
 
+# Expand a cpu list such as "2-5,8" into "2 3 4 5 8"
+expand_cpu_list ()
+{
+	local range list
+
+	for range in ${1//,/ }; do
+		if [[ $range =~ ^([0-9]+)-([0-9]+)$ ]]; then
+			list+=" $(seq -s ' ' ${BASH_REMATCH[1]} ${BASH_REMATCH[2]})"
+		elif [[ $range =~ ^[0-9]+$ ]]; then
+			list+=" $range"
+		else
+			return 1
+		fi
+	done
+	echo $list
+}
+
+# Start QEMU stopped, pin its threads to the host CPUs in $PIN_CPUS and
+# only then let the guest run.  The first CPU of the set gets the main
+# loop (I/O) thread along with any other helper thread, and each vCPU
+# thread gets a dedicated CPU from the rest of the set.  For reproducible
+# results the CPUs should also be isolated from the host scheduler and
+# interrupts, e.g. with isolcpus= and nohz_full=.
+run_pinned ()
+{
+	local qmp pid qemu_pid tid cpus io_cpu vcpu_tids i tries
+
+	if ! command -v nc >/dev/null 2>&1; then
+		echo "${FUNCNAME[0]} needs nc (netcat)" >&2
+		return 2
+	fi
+
+	cpus=($(expand_cpu_list "$PIN_CPUS")) || {
+		echo "Bad PIN_CPUS cpu list: $PIN_CPUS" >&2
+		return 2
+	}
+
+	qmp=`mktemp -u -t pin-helper-qmp.XXXXXXXXXX`
+
+	trap 'kill 0; exit 2' INT TERM
+	trap 'rm -f ${qmp}' RETURN EXIT
+
+	eval "$@" -S -chardev socket,id=mon-pin,path=${qmp},server,nowait \
+		-mon chardev=mon-pin,mode=control &
+	pid=$!
+
+	for (( tries = 0; tries < 100; tries++ )); do
+		[ -S ${qmp} ] && break
+		kill -0 $pid 2>/dev/null || break
+		sleep 0.1
+	done
+	if [ ! -S ${qmp} ]; then
+		wait $pid
+		return
+	fi
+
+	vcpu_tids=($(qmp ${qmp} '"query-cpus-fast"' |
+		     grep -o '"thread-id": *[0-9]*' | grep -o '[0-9]*$'))
+	if (( ${#vcpu_tids[@]} == 0 )); then
+		# QEMU older than 2.12
+		vcpu_tids=($(qmp ${qmp} '"query-cpus"' |
+			     grep -o '"thread_id": *[0-9]*' | grep -o '[0-9]*$'))
+	fi
+	if (( ${#vcpu_tids[@]} == 0 )); then
+		# QEMU is gone already, let its status speak
+		wait $pid
+		return
+	fi
+
+	if (( ${#vcpu_tids[@]} >= ${#cpus[@]} )); then
+		echo "Cannot pin ${#vcpu_tids[@]} vCPUs and the I/O thread" \
+		     "to host CPUs $PIN_CPUS" >&2
+		qmp ${qmp} '"quit"' > /dev/null 2>&1
+		wait $pid
+		return 2
+	fi
+
+	io_cpu=${cpus[0]}
+	qemu_pid=$(awk '/^Tgid:/ { print $2 }' /proc/${vcpu_tids[0]}/status)
+	taskset -a -p -c $io_cpu $qemu_pid > /dev/null
+	echo "pinned QEMU I/O thread $qemu_pid to host CPU $io_cpu"
+
+	for i in ${!vcpu_tids[@]}; do
+		tid=${vcpu_tids[$i]}
+		taskset -p -c ${cpus[$((i + 1))]} $tid > /dev/null
+		echo "pinned vCPU $i thread $tid to host CPU ${cpus[$((i + 1))]}"
+	done
+
+	qmp ${qmp} '"cont"' > /dev/null
+	wait $pid
+}
+
+pin_cmd ()
+{
+	# migration starts two QEMUs and already runs its own QMP monitors
+	if [ "$PIN_CPUS" ] && [ "$MIGRATION" != "yes" ]; then
+		echo "run_pinned"
+	fi
+}
+
+# Record the KVM tracepoints of the test with "perf kvm stat", and write
+# the exit counts and times per exit reason to $KVMSTAT_DIR/$TESTNAME.kvmstat
+run_kvmstat ()
+{
+	local data status ret
+
+	if ! command -v perf >/dev/null 2>&1; then
+		echo "${FUNCNAME[0]} needs perf" >&2
+		return 2
+	fi
+
+	data=`mktemp -t kvmstat-helper-data.XXXXXXXXXX`
+	status=`mktemp -t kvmstat-helper-status.XXXXXXXXXX`
+
+	trap 'rm -f ${data} ${status}' RETURN EXIT
+
+	# Don't rely on perf to pass the exit status of QEMU through
+	perf kvm stat record -q -o ${data} -- \
+		bash -c '"$@"; echo $? > '"${status}" run_kvmstat "$@"
+	ret=$(cat ${status})
+
+	perf kvm stat report -i ${data} --event=vmexit 2>/dev/null \
+		> "${KVMSTAT_DIR:-.}/${TESTNAME:-qemu}.kvmstat"
+
+	return ${ret:-2}
+}
+
+kvmstat_cmd ()
+{
+	# migration would have both QEMUs write the same file
+	if [ "$KVMSTAT_DIR" ] && [ "$MIGRATION" != "yes" ]; then
+		echo "run_kvmstat"
+	fi
+}
+
 search_qemu_binary ()
 {
 	local save_path=$PATH
@@ -216,12 +430,13 @@ env_add_errata ()
 		env_generate_errata
 	fi
 
-	if grep -q '^ERRATA_' <(env); then
+	# REPORT_* variables, e.g. REPORT_QUIET, are passed on along with the errata
+	if grep -qE '^(ERRATA|REPORT)_' <(env); then
 		export KVM_UNIT_TESTS_ENV_OLD="$KVM_UNIT_TESTS_ENV"
 		export KVM_UNIT_TESTS_ENV=$(mktemp)
 		trap_exit_push 'rm -f $KVM_UNIT_TESTS_ENV; [ "$KVM_UNIT_TESTS_ENV_OLD" ] && export KVM_UNIT_TESTS_ENV="$KVM_UNIT_TESTS_ENV_OLD" || unset KVM_UNIT_TESTS_ENV; unset KVM_UNIT_TESTS_ENV_OLD'
-		[ -f "$KVM_UNIT_TESTS_ENV_OLD" ] && grep -v '^ERRATA_' "$KVM_UNIT_TESTS_ENV_OLD" > $KVM_UNIT_TESTS_ENV
-		grep '^ERRATA_' <(env) >> $KVM_UNIT_TESTS_ENV
+		[ -f "$KVM_UNIT_TESTS_ENV_OLD" ] && grep -vE '^(ERRATA|REPORT)_' "$KVM_UNIT_TESTS_ENV_OLD" > $KVM_UNIT_TESTS_ENV
+		grep -E '^(ERRATA|REPORT)_' <(env) >> $KVM_UNIT_TESTS_ENV
 		ret=0
 	fi
 
@@ -48,3 +48,59 @@ function for_each_unittest()
 	"$cmd" "$testname" "$groups" "$smp" "$kernel" "$opts" "$arch" "$check" "$accel" "$timeout"
 	exec {fd}<&-
 }
+
+# Print the tests of shard $2 out of $3 (numbered from 1) for the
+# unittests.cfg in $1.  Tests are handed out longest first, each to the
+# shard with the least work so far, using the average wall times in the
+# results.json file $4.  Tests missing from $4 are assumed to take as
+# long as the average test.  The result only depends on the arguments,
+# so that independent runs agree on the partition.
+function shard_unittests()
+{
+	local unittests="$1"
+	local shard="$2"
+	local nr_shards="$3"
+	local durations="$4"
+
+	sed -n 's/^\[\(.*\)\]$/\1/p' "$unittests" |
+	awk -v shard="$shard" -v nr_shards="$nr_shards" -v durations="$durations" '
+	BEGIN {
+		while (durations != "" && (getline line < durations) > 0) {
+			if (!match(line, /"name": "[^"]*"/))
+				continue
+			name = substr(line, RSTART + 9, RLENGTH - 10)
+			if (!match(line, /"wall_time": [0-9.]+/))
+				continue
+			sum[name] += substr(line, RSTART + 13, RLENGTH - 13)
+			count[name]++
+		}
+	}
+	{ tests[NR] = $0 }
+	END {
+		for (name in sum) {
+			total += sum[name] / count[name]
+			known++
+		}
+		avg = known ? total / known : 1
+		for (i = 1; i <= NR; i++) {
+			t = tests[i]
+			cost[i] = (t in count) ? sum[t] / count[t] : avg
+			order[i] = i
+		}
+		# longest first, ties in unittests.cfg order
+		for (i = 2; i <= NR; i++) {
+			for (j = i; j > 1 && cost[order[j]] > cost[order[j - 1]]; j--) {
+				k = order[j]; order[j] = order[j - 1]; order[j - 1] = k
+			}
+		}
+		for (i = 1; i <= NR; i++) {
+			s = 1
+			for (j = 2; j <= nr_shards; j++)
+				if (load[j] < load[s])
+					s = j
+			load[s] += cost[order[i]]
+			if (s == shard)
+				print tests[order[i]]
+		}
+	}'
+}
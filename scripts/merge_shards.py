@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+#
+# Merge the logs directories of several run_tests.sh --shard runs into
+# one, and print a summary of the whole suite.
+#
+#   ./scripts/merge_shards.py -o logs shard1/logs shard2/logs ...
+#
+# Test logs are copied to the output directory, results.json and
+# results.xml are combined, and the TAP outputs given with --tap are
+# renumbered into one TAP stream in results.tap.  The merged
+# results.json can be passed to run_tests.sh --durations to balance the
+# next sharded run.  Exits with 1 if any test failed.
+#
+# This work is licensed under the terms of the GNU LGPL, version 2.
+
+import argparse
+import json
+import os
+import re
+import shutil
+import sys
+
+# Files that are merged rather than copied
+MERGED = ('SUMMARY', 'results.json', 'results.xml')
+
+def error(msg):
+    sys.stderr.write('%s\n' % msg)
+    sys.exit(2)
+
+def read_lines(path):
+    with open(path) as f:
+        return f.read().splitlines()
+
+def merge_logs(shards, outdir):
+    for shard in shards:
+        for name in sorted(os.listdir(shard)):
+            if name in MERGED:
+                continue
+            dest = os.path.join(outdir, name)
+            if os.path.exists(dest):
+                error('%s appears in several shards' % name)
+            shutil.copy2(os.path.join(shard, name), dest)
+
+def merge_summary(shards, outdir):
+    heads = set()
+    for shard in shards:
+        path = os.path.join(shard, 'SUMMARY')
+        if os.path.exists(path):
+            heads.update(line for line in read_lines(path)
+                         if line.startswith('BUILD_HEAD='))
+    if len(heads) > 1:
+        sys.stderr.write('warning: shards ran different builds: %s\n' %
+                         ', '.join(sorted(heads)))
+    with open(os.path.join(outdir, 'SUMMARY'), 'w') as f:
+        for head in sorted(heads):
+            f.write('%s\n' % head)
+
+def merge_json(shards, outdir):
+    merged = None
+    for shard in shards:
+        path = os.path.join(shard, 'results.json')
+        if not os.path.exists(path):
+            continue
+        with open(path) as f:
+            results = json.load(f)
+        if merged is None:
+            merged = { 'build_head': results['build_head'],
+                       'arch': results['arch'],
+                       'shards': [],
+                       'tests': [] }
+        elif results['arch'] != merged['arch']:
+            error('%s: shards ran on different architectures' % path)
+        merged['shards'].append({ 'shard': results.get('shard'),
+                                  'logs': shard,
+                                  'wall_time': sum(t['wall_time']
+                                                   for t in results['tests']) })
+        merged['tests'] += results['tests']
+
+    # Same layout as run_tests.sh, one test per line, which is what
+    # run_tests.sh --durations parses
+    if merged is not None:
+        with open(os.path.join(outdir, 'results.json'), 'w') as f:
+            f.write('{ "build_head": %s, "arch": %s,\n' %
+                    (json.dumps(merged['build_head']),
+                     json.dumps(merged['arch'])))
+            f.write('  "shards": %s,\n' % json.dumps(merged['shards']))
+            f.write('  "tests": [\n')
+            f.write(',\n'.join('    %s' % json.dumps(t)
+                               for t in merged['tests']))
+            f.write('\n  ]\n}\n')
+    return merged
+
+def merge_junit(shards, outdir):
+    testcases = []
+    found = False
+    for shard in shards:
+        path = os.path.join(shard, 'results.xml')
+        if not os.path.exists(path):
+            continue
+        found = True
+        testcases += [line for line in read_lines(path)
+                      if line.startswith('<testcase')]
+    if not found:
+        return
+
+    with open(os.path.join(outdir, 'results.xml'), 'w') as f:
+        f.write('<?xml version="1.0" encoding="UTF-8"?>\n')
+        f.write('<testsuites>\n')
+        f.write('<testsuite name="kvm-unit-tests" tests="%d" failures="%d" '
+                'skipped="%d">\n' %
+                (len(testcases),
+                 sum('<failure' in t for t in testcases),
+                 sum('<skipped' in t for t in testcases)))
+        for t in testcases:
+            f.write('%s\n' % t)
+        f.write('</testsuite>\n')
+        f.write('</testsuites>\n')
+
+def merge_tap(taps, outdir):
+    # Returns the number of "not ok" lines.
+    result = re.compile(r'^(ok|not ok) [0-9]+(.*)$')
+    number = 0
+    failures = 0
+    with open(os.path.join(outdir, 'results.tap'), 'w') as f:
+        f.write('TAP version 13\n')
+        for tap in taps:
+            for line in read_lines(tap):
+                if line == 'TAP version 13' or re.match(r'^1\.\.[0-9]+$', line):
+                    continue
+                m = result.match(line)
+                if m:
+                    number += 1
+                    if m.group(1) == 'not ok':
+                        failures += 1
+                    line = '%s %d%s' % (m.group(1), number, m.group(2))
+                f.write('%s\n' % line)
+        f.write('1..%d\n' % number)
+    return failures
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Merge the logs of sharded run_tests.sh runs')
+    parser.add_argument('shards', nargs='+', metavar='LOGS',
+                        help='logs directory of one shard')
+    parser.add_argument('-o', '--output', default='logs',
+                        help='merged logs directory (default logs)')
+    parser.add_argument('--tap', action='append', default=[],
+                        help='TAP output of one shard (run_tests.sh -t)')
+    args = parser.parse_args()
+
+    for shard in args.shards:
+        if not os.path.isdir(shard):
+            error('%s is not a directory' % shard)
+    if os.path.exists(args.output) and os.listdir(args.output):
+        error('%s already exists and is not empty' % args.output)
+    os.makedirs(args.output, exist_ok=True)
+
+    merge_logs(args.shards, args.output)
+    merge_summary(args.shards, args.output)
+    results = merge_json(args.shards, args.output)
+    merge_junit(args.shards, args.output)
+
+    failures = 0
+    if args.tap:
+        failures = merge_tap(args.tap, args.output)
+
+    if results is not None:
+        for shard in results['shards']:
+            print('%s (shard %s): %.1fs' %
+                  (shard['logs'], shard['shard'] or '-', shard['wall_time']))
+        counts = {}
+        for test in results['tests']:
+            counts[test['status']] = counts.get(test['status'], 0) + 1
+            if test['status'] == 'FAIL':
+                print('FAIL %s (%s)' % (test['name'], test['message']))
+        failures = max(failures, counts.get('FAIL', 0))
+        print('%d tests: %d passed, %d failed, %d skipped' %
+              (len(results['tests']), counts.get('PASS', 0),
+               counts.get('FAIL', 0), counts.get('SKIP', 0)))
+    elif args.tap:
+        print('%d failed tests in TAP output' % failures)
+
+    if failures:
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
@@ -99,6 +99,146 @@ function mkstandalone()
 	echo Written $standalone.
 }
 
+# Rewrite the file = lines of a unittests.cfg to point to content-addressed
+# copies of the kernels, which are stored in $2.
+bundle_cfg ()
+{
+	local unittests="$1"
+	local kernels="$2"
+	local line kernel hash
+
+	while IFS= read -r line; do
+		if [[ $line =~ ^file\ *=\ *(.*)$ ]] &&
+		   kernel=$TEST_DIR/${BASH_REMATCH[1]} && [ -f "$kernel" ]; then
+			hash=$(sha256sum "$kernel" | cut -d' ' -f1)
+			cp -n "$kernel" "$kernels/$hash.${kernel##*.}"
+			echo "file = ../kernels/$hash.${kernel##*.}"
+		else
+			echo "$line"
+		fi
+	done < "$unittests"
+}
+
+generate_bundle_launcher ()
+{
+	local bundle_id="$1"
+	local payload_line="$2"
+
+	cat <<EOF
+#!/usr/bin/env bash
+#
+# Self-extracting kvm-unit-tests bundle, BUILD_HEAD=$(cat build-head)
+#
+# Usage: \$0 [run_tests.sh options] [test...]
+#
+# The bundle is extracted once into \$KVM_UNIT_TESTS_CACHE, by default
+# ~/.cache/kvm-unit-tests, where identical kernels are shared between
+# bundles.  Logs are written to ./logs.
+
+bundle_id=$bundle_id
+payload_line=$payload_line
+EOF
+
+	cat <<'EOF'
+
+: ${KVM_UNIT_TESTS_CACHE:=${XDG_CACHE_HOME:-$HOME/.cache}/kvm-unit-tests}
+tree=$KVM_UNIT_TESTS_CACHE/bundles/$bundle_id
+
+if [ ! -d "$tree" ]; then
+	mkdir -p "$KVM_UNIT_TESTS_CACHE/kernels" "$KVM_UNIT_TESTS_CACHE/bundles" ||
+		exit 2
+	tmp=$(mktemp -d "$KVM_UNIT_TESTS_CACHE/bundles/.extract.XXXXXXXXXX") ||
+		exit 2
+	tail -n +$payload_line "$0" | tar -xz -C "$tmp" || {
+		rm -rf "$tmp"
+		exit 2
+	}
+	for kernel in "$tmp"/kernels/*; do
+		[ -f "$KVM_UNIT_TESTS_CACHE/kernels/${kernel##*/}" ] ||
+			mv "$kernel" "$KVM_UNIT_TESTS_CACHE/kernels/"
+	done
+	rm -rf "$tmp/kernels"
+	ln -s ../../kernels "$tmp/kernels"
+	# somebody else may have extracted the same bundle meanwhile
+	mv -T "$tmp" "$tree" 2>/dev/null || rm -rf "$tmp"
+fi
+
+# run_tests.sh runs in $tree, so make the files it is given absolute
+args=()
+while (( $# )); do
+	case "$1" in
+	--baseline|--durations|--cache)
+		args+=("$1")
+		shift
+		(( $# )) || break
+		[[ "$1" = /* ]] || set -- "$PWD/$1" "${@:2}"
+		;;
+	--baseline=*|--durations=*|--cache=*)
+		[[ "${1#*=}" = /* ]] || set -- "${1%%=*}=$PWD/${1#*=}" "${@:2}"
+		;;
+	esac
+	args+=("$1")
+	shift
+done
+
+export HOST=$(uname -m | sed -e 's/i.86/i386/;s/arm.*/arm/;s/ppc64.*/ppc64/')
+export unittest_log_dir=${unittest_log_dir:-$PWD/logs}
+cd "$tree" && exec ./run_tests.sh "${args[@]}"
+exit 2
+EOF
+}
+
+# Build a single self-extracting script that holds every kernel only once,
+# together with the runner, and runs tests through run_tests.sh.
+mkbundle ()
+{
+	local bundle=tests/kvm-unit-tests-$ARCH.bundle
+	local tree payload launcher bundle_id lines
+
+	tree=$(mktemp -d)
+	payload=$(mktemp)
+	trap 'rm -rf $tree $payload' EXIT
+
+	mkdir -p $tree/scripts $tree/$TEST_DIR $tree/kernels
+	cp run_tests.sh build-head $tree
+	cp scripts/arch-run.bash scripts/common.bash scripts/runtime.bash \
+		scripts/perf_compare.py scripts/merge_shards.py $tree/scripts
+	cp $TEST_DIR/run $tree/$TEST_DIR
+	bundle_cfg $TEST_DIR/unittests.cfg $tree/kernels > $tree/$TEST_DIR/unittests.cfg
+
+	{
+		grep -E '^(ARCH|ARCH_NAME|PROCESSOR|TEST_DIR|ENDIAN)=' config.mak
+		echo "PRETTY_PRINT_STACKS=no"
+		echo "ENVIRON_DEFAULT=yes"
+		if [ "$ERRATATXT" ]; then
+			cp "$ERRATATXT" $tree/errata.txt
+			echo "ERRATATXT=errata.txt"
+		fi
+		if [ "$FIRMWARE" ]; then
+			mkdir $tree/firmware
+			cp "$FIRMWARE" $tree/firmware
+			echo "FIRMWARE=firmware/$(basename $FIRMWARE)"
+		fi
+	} > $tree/config.mak
+
+	tar -C $tree -cz . > $payload
+	bundle_id=$(sha256sum $payload | cut -d' ' -f1)
+
+	# The launcher needs to know its own length to find the payload.
+	lines=$(generate_bundle_launcher $bundle_id 0 | wc -l)
+	generate_bundle_launcher $bundle_id $((lines + 1)) > $bundle
+	cat $payload >> $bundle
+
+	chmod +x $bundle
+	echo Written $bundle.
+}
+
+if [ "$1" = "--bundle" ]; then
+	mkdir -p tests
+	mkbundle
+	exit
+fi
+
 trap 'rm -f $cfg' EXIT
 cfg=$(mktemp)
 
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+#
+# Compare the PERF metrics of a run_tests.sh --json results file against
+# a baseline results file, and flag statistically significant regressions.
+#
+# Each (test, metric) pair is treated as a sample set, with one value per
+# repetition (run_tests.sh --repeat).  A metric regresses if a rank-sum
+# test says the difference is significant AND the median moved in the bad
+# direction by more than the threshold.  A bootstrap confidence interval
+# of the relative median change is printed along with the verdict, so that
+# noisy metrics are easy to spot.
+#
+# This work is licensed under the terms of the GNU LGPL, version 2.
+
+import argparse
+import json
+import random
+import sys
+
+RESAMPLES = 10000
+
+# Metrics measured in these units are better when higher, everything else
+# (cycles, ns, ps, ...) is a cost.
+HIGHER_IS_BETTER = ('/s', 'ops')
+
+def puts(string):
+    sys.stdout.write(string)
+    sys.stdout.flush()
+
+def color(status):
+    colors = { 'PASS': 32, 'SKIP': 33, 'FAIL': 31 }
+    return '\x1b[%dm%s\x1b[0m' % (colors[status], status)
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    if n % 2:
+        return values[n // 2]
+    return (values[n // 2 - 1] + values[n // 2]) / 2.0
+
+def load_samples(path):
+    # Returns { (test, metric): { 'unit': unit, 'values': [...] } }.  The
+    # same metric may be printed several times by one run of a test (e.g.
+    # one line per pci-testdev subtest), so occurrences are numbered.
+    with open(path) as f:
+        results = json.load(f)
+
+    samples = {}
+    for test in results['tests']:
+        if test['status'] != 'PASS':
+            continue
+        seen = {}
+        for perf in test['perf']:
+            metric = perf['metric']
+            seen[metric] = seen.get(metric, 0) + 1
+            if seen[metric] > 1:
+                metric = '%s#%d' % (metric, seen[metric])
+            key = (test['name'], metric)
+            entry = samples.setdefault(key, { 'unit': perf['unit'],
+                                              'values': [] })
+            entry['values'].append(float(perf['value']))
+    return samples
+
+def ranks(values):
+    # Ranks starting at 1, ties get the average rank.
+    order = sorted(range(len(values)), key=lambda i: values[i])
+    r = [0.0] * len(values)
+    i = 0
+    while i < len(order):
+        j = i
+        while j + 1 < len(order) and values[order[j + 1]] == values[order[i]]:
+            j += 1
+        for k in range(i, j + 1):
+            r[order[k]] = (i + j) / 2.0 + 1
+        i = j + 1
+    return r
+
+def rank_sum_test(base, cur, rng):
+    # Two-sided p-value of the Wilcoxon rank-sum (Mann-Whitney) test,
+    # computed by permutation so that it holds for small sample sizes.
+    r = ranks(base + cur)
+    n = len(base)
+    expected = n * (len(r) + 1) / 2.0
+    observed = abs(sum(r[:n]) - expected)
+    hits = 0
+    for i in range(RESAMPLES):
+        rng.shuffle(r)
+        if abs(sum(r[:n]) - expected) >= observed - 1e-9:
+            hits += 1
+    return (hits + 1.0) / (RESAMPLES + 1.0)
+
+def bootstrap_ci(base, cur, confidence, rng):
+    # Confidence interval of the relative change of the median.
+    changes = []
+    for i in range(RESAMPLES):
+        b = median([rng.choice(base) for v in base])
+        c = median([rng.choice(cur) for v in cur])
+        if b:
+            changes.append((c - b) / b)
+    changes.sort()
+    if not changes:
+        return 0.0, 0.0
+    lo = int((1 - confidence) / 2 * len(changes))
+    hi = min(len(changes) - 1, int((1 + confidence) / 2 * len(changes)))
+    return changes[lo], changes[hi]
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compare PERF metrics against a baseline')
+    parser.add_argument('baseline', help='baseline results.json')
+    parser.add_argument('results', help='current results.json')
+    parser.add_argument('-t', '--threshold', type=float, default=10.0,
+                        help='regression threshold in percent (default 10)')
+    parser.add_argument('-c', '--confidence', type=float, default=0.95,
+                        help='confidence level (default 0.95)')
+    args = parser.parse_args()
+
+    base_samples = load_samples(args.baseline)
+    cur_samples = load_samples(args.results)
+    alpha = 1 - args.confidence
+    threshold = args.threshold / 100
+    rng = random.Random(0)
+    regressions = 0
+
+    for key in sorted(cur_samples):
+        test, metric = key
+        cur = cur_samples[key]['values']
+        unit = cur_samples[key]['unit']
+        if key not in base_samples:
+            puts('%s %s %s (not in baseline)\n' % (color('SKIP'), test, metric))
+            continue
+
+        base = base_samples[key]['values']
+        b, c = median(base), median(cur)
+        if not b:
+            puts('%s %s %s (zero baseline)\n' % (color('SKIP'), test, metric))
+            continue
+
+        change = (c - b) / b
+        lo, hi = bootstrap_ci(base, cur, args.confidence, rng)
+        p = rank_sum_test(base, cur, rng)
+
+        worse = -change if unit.endswith(HIGHER_IS_BETTER) else change
+        status = 'PASS'
+        if p < alpha and worse > threshold:
+            status = 'FAIL'
+            regressions += 1
+
+        puts('%s %s %s: %g -> %g %s (%+.1f%%, %d%% CI %+.1f%%..%+.1f%%, '
+             'p=%.3f, n=%d/%d)\n' %
+             (color(status), test, metric, b, c, unit, change * 100,
+              args.confidence * 100, lo * 100, hi * 100, p,
+              len(base), len(cur)))
+
+    if regressions:
+        puts('%d performance regression(s) beyond %g%%\n' %
+             (regressions, args.threshold))
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
@@ -12,6 +12,57 @@ def puts(string):
     sys.stdout.write(string)
     sys.stdout.flush()
 
+class Symbolizer:
+    # One long-lived addr2line per binary.  With -i the number of output
+    # lines per address varies, so each batch of addresses is terminated
+    # by address 0, which addr2line answers with a "0x000...: ?? ??:0" line.
+    def __init__(self, binary):
+        cmd = [config.get('ADDR2LINE', 'addr2line'), '-e', binary, '-i', '-f',
+               '--pretty', '--address']
+        self.proc = subprocess.Popen(cmd, stdin=subprocess.PIPE,
+                                     stdout=subprocess.PIPE,
+                                     universal_newlines=True)
+        self.cache = {}
+
+    def symbolize(self, addrs):
+        todo = [a for a in dict.fromkeys(addrs) if a not in self.cache]
+        if todo:
+            self.proc.stdin.write('\n'.join(todo) + '\n0\n')
+            self.proc.stdin.flush()
+
+            lines = []
+            while True:
+                line = self.proc.stdout.readline()
+                if line == '':
+                    raise IOError('addr2line exited')
+                if re.match(r'0x0+: ', line):
+                    break
+                lines.append(line.rstrip('\n'))
+
+            # Each address starts a new group, inlined-by lines follow it.
+            groups = []
+            for line in lines:
+                if line.startswith(' ') and groups:
+                    groups[-1].append(line)
+                else:
+                    groups.append([line])
+            if len(groups) != len(todo):
+                raise IOError('unexpected addr2line output')
+            self.cache.update(zip(todo, groups))
+
+        return [l for a in addrs for l in self.cache[a]]
+
+symbolizers = {}
+sources = {}
+
+def source_lines(path):
+    if path not in sources:
+        try:
+            sources[path] = open(path).readlines()
+        except IOError:
+            sources[path] = None
+    return sources[path]
+
 def pretty_print_stack(binary, line):
     addrs = line.split()[1:]
     # Addresses are return addresses unless preceded by a '@'. We want the
@@ -27,27 +78,26 @@ def pretty_print_stack(binary, line):
     # Output like this:
     #        0x004002be: start64 at path/to/kvm-unit-tests/x86/cstart64.S:208
     #         (inlined by) test_ept_violation at path/to/kvm-unit-tests/x86/vmx_tests.c:1719 (discriminator 1)
-    cmd = [config.get('ADDR2LINE', 'addr2line'), '-e', binary, '-i', '-f', '--pretty', '--address']
-    cmd.extend(addrs)
-
-    p = subprocess.Popen(cmd, stdout=subprocess.PIPE)
-    out, err = p.communicate()
-    if p.returncode != 0:
+    if binary not in symbolizers:
+        symbolizers[binary] = Symbolizer(binary)
+    try:
+        out = symbolizers[binary].symbolize(addrs)
+    except IOError:
+        del symbolizers[binary]
         puts(line)
         return
 
-    for line in out.splitlines():
-        m = re.match(b'(.*) at [^ ]*/kvm-unit-tests/([^ ]*):([0-9]+)(.*)', line)
+    for line in out:
+        m = re.match('(.*) at [^ ]*/kvm-unit-tests/([^ ]*):([0-9]+)(.*)', line)
         if m is None:
             puts('%s\n' % line)
             return
 
         head, path, line, tail = m.groups()
         line = int(line)
-        puts('%s at %s:%d%s\n' % (head.decode(), path.decode(), line, tail.decode()))
-        try:
-            lines = open(path).readlines()
-        except IOError:
+        puts('%s at %s:%d%s\n' % (head, path, line, tail))
+        lines = source_lines(path)
+        if lines is None:
             continue
         if line > 1:
             puts('        %s\n' % lines[line - 2].rstrip())
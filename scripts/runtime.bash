@@ -12,6 +12,155 @@ extract_summary()
     tail -3 | grep '^SUMMARY: ' | sed 's/^SUMMARY: /(/;s/'"$cr"'\{0,1\}$/)/'
 }
 
+now_ms()
+{
+    echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# The first line of output is the command line echoed by run_qemu, and
+# with PIN_CPUS run_pinned then reports its pinning before the guest is
+# started, so the first other line is the first thing the guest prints.
+stamp_first_output()
+{
+    local line
+
+    read -r line
+    while read -r line; do
+        [[ "$line" == "pinned "* ]] && continue
+        now_ms > "$1"
+        break
+    done
+    cat > /dev/null
+}
+
+extract_perf()
+{
+    local cr=$'\r'
+    grep '^PERF: ' | sed 's/'"$cr"'\{0,1\}$//'
+}
+
+# Used instead of extract_summary when results are recorded, in which case
+# PERF lines are passed through along with the summary.
+extract_results()
+{
+    local out
+
+    exec {out}>&1
+    tee >(stamp_first_output "$RUNTIME_stamp_file") >(extract_perf >&$out) |
+        extract_summary
+    exec {out}>&-
+}
+
+json_escape()
+{
+    local s="${1//\\/\\\\}"
+    s="${s//\"/\\\"}"
+    s="${s//$'\t'/ }"
+    echo -n "${s//$'\r'/}"
+}
+
+xml_escape()
+{
+    local s="${1//&/&amp;}"
+    s="${s//</&lt;}"
+    s="${s//>/&gt;}"
+    s="${s//\"/&quot;}"
+    echo -n "${s//$'\r'/}"
+}
+
+ms_to_sec()
+{
+    printf "%d.%03d" $(($1 / 1000)) $(($1 % 1000))
+}
+
+# Summarize the "perf kvm stat report" output of a test as JSON
+kvmstat_json()
+{
+    awk '
+        /^ *[A-Za-z0-9_]+ +[0-9]+ +[0-9.]+%/ {
+            reasons = reasons (reasons ? ", " : "") "\"" $1 "\": " $2
+        }
+        /Total Samples:/ {
+            split($0, f, /[:,]/)
+            exits = f[2] + 0
+            time = f[4]
+            sub(/us.*/, "", time)
+        }
+        END {
+            printf "{ \"exits\": %d, \"time_us\": %s, \"reasons\": { %s } }",
+                   exits, time ? time : 0, reasons
+        }' "$1"
+}
+
+# Append one JSON object per line to $RUNTIME_results_file, and one JUnit
+# <testcase> per line to $RUNTIME_junit_file.  Writes are small single-line
+# appends, so parallel tasks don't interleave.
+function record_result()
+{
+    local status="$1"
+    local message="$2"
+    local end wall startup perf_json line metric value unit junit kvmstat
+
+    [ -z "$RUNTIME_results_file" ] && return
+
+    end=$(now_ms)
+    wall=$(ms_to_sec $((end - ${start_ms:-$end})))
+    startup=null
+    if [ -n "$first_output_ms" ]; then
+        startup=$(ms_to_sec $((first_output_ms - start_ms)))
+    fi
+
+    perf_json=
+    while read -r line; do
+        read -r metric value unit <<<"${line#PERF: }"
+        [[ $value =~ ^-?[0-9]+(\.[0-9]+)?$ ]] || continue
+        [ "$perf_json" ] && perf_json+=", "
+        perf_json+="{ \"metric\": \"$(json_escape "$metric")\","
+        perf_json+=" \"value\": $value, \"unit\": \"$(json_escape "$unit")\" }"
+    done <<<"$perf"
+
+    kvmstat=
+    if [ "$KVMSTAT_DIR" ] && [ -s "$KVMSTAT_DIR/$testname.kvmstat" ]; then
+        kvmstat=$(kvmstat_json "$KVMSTAT_DIR/$testname.kvmstat")
+    fi
+
+    echo "{ \"name\": \"$(json_escape "$testname")\"," \
+         "\"groups\": \"$(json_escape "$groups")\"," \
+         "\"iteration\": ${RUNTIME_iteration:-1}," \
+         "\"status\": \"$status\", \"exit_status\": ${ret:-null}," \
+         "\"wall_time\": $wall, \"qemu_startup\": $startup," \
+         "\"message\": \"$(json_escape "$message")\"," \
+         "${kvmstat:+\"kvmstat\": $kvmstat,}" \
+         "\"perf\": [$perf_json] }" >> "$RUNTIME_results_file"
+
+    [ -z "$RUNTIME_junit_file" ] && return
+
+    junit="<testcase name=\"$(xml_escape "$testname")\""
+    junit+=" classname=\"$(xml_escape "${groups:-kvm-unit-tests}")\" time=\"$wall\">"
+    case "$status" in
+        FAIL) junit+="<failure message=\"$(xml_escape "$message")\"/>" ;;
+        SKIP) junit+="<skipped message=\"$(xml_escape "$message")\"/>" ;;
+    esac
+    if [ "$perf" ]; then
+        line=$(xml_escape "$perf")
+        junit+="<system-out>${line//$'\n'/&#10;}</system-out>"
+    fi
+    junit+="</testcase>"
+    echo "$junit" >> "$RUNTIME_junit_file"
+}
+
+# Key the result of a test on everything it depends on: its kernel, its
+# unittests.cfg stanza and $RUNTIME_cache_env, which covers QEMU, the host
+# kernel and the errata.
+cache_key()
+{
+    {
+        echo "$RUNTIME_cache_env"
+        sha256sum < "$kernel"
+        echo "$testname|$groups|$smp|$opts|$arch|$check|$accel|$timeout"
+    } | sha256sum | cut -d' ' -f1
+}
+
 # We assume that QEMU is going to work if it tried to load the kernel
 premature_failure()
 {
@@ -63,8 +212,10 @@ function print_result()
 
     if [ -z "$reason" ]; then
         echo "`$status` $testname $summary"
+        record_result "$status" "$summary"
     else
         echo "`$status` $testname ($reason)"
+        record_result "$status" "$reason"
     fi
 }
 
@@ -79,6 +230,8 @@ function run()
     local check="${CHECK:-$7}"
     local accel="${ACCEL:-$8}"
     local timeout="${9:-$TIMEOUT}" # unittests.cfg overrides the default
+    local start_ms first_output_ms perf ret cache_file cached_status
+    local summary_filter=extract_summary
 
     if [ -z "$testname" ]; then
         return
@@ -115,6 +268,17 @@ function run()
         fi
     done
 
+    if [ "$RUNTIME_cache_dir" ] && [ -f "$kernel" ]; then
+        cache_file="$RUNTIME_cache_dir/$(cache_key)"
+        if [ -f "$cache_file" ]; then
+            read -r cached_status summary < "$cache_file"
+            ret=0
+            [ "$cached_status" = "SKIP" ] && ret=77
+            print_result "$cached_status" $testname "$summary [cached]"
+            return $ret
+        fi
+    fi
+
     last_line=$(premature_failure > >(tail -1)) && {
         print_result "SKIP" $testname "" "$last_line"
         return 77
@@ -128,18 +292,34 @@ function run()
         echo $cmdline
     fi
 
+    if [ "$RUNTIME_results_file" ]; then
+        local RUNTIME_stamp_file="$RUNTIME_results_file.$testname.stamp"
+        rm -f "$RUNTIME_stamp_file"
+        summary_filter=extract_results
+    fi
+
     # extra_params in the config file may contain backticks that need to be
     # expanded, so use eval to start qemu.  Use "> >(foo)" instead of a pipe to
     # preserve the exit status.
+    start_ms=$(now_ms)
     summary=$(eval $cmdline 2> >(RUNTIME_log_stderr) \
-                             > >(tee >(RUNTIME_log_stdout $kernel) | extract_summary))
+                             > >(tee >(RUNTIME_log_stdout $kernel) | $summary_filter))
     ret=$?
     [ "$STANDALONE" != "yes" ] && echo > >(RUNTIME_log_stdout $kernel)
 
+    if [ "$RUNTIME_results_file" ]; then
+        perf=$(grep '^PERF: ' <<<"$summary")
+        summary=$(grep -v '^PERF: ' <<<"$summary")
+        [ -f "$RUNTIME_stamp_file" ] && first_output_ms=$(cat "$RUNTIME_stamp_file")
+        rm -f "$RUNTIME_stamp_file"
+    fi
+
     if [ $ret -eq 0 ]; then
         print_result "PASS" $testname "$summary"
+        [ "$cache_file" ] && echo "PASS $summary" > "$cache_file"
     elif [ $ret -eq 77 ]; then
         print_result "SKIP" $testname "$summary"
+        [ "$cache_file" ] && echo "SKIP $summary" > "$cache_file"
     elif [ $ret -eq 124 ]; then
         print_result "FAIL" $testname "" "timeout; duration=$timeout"
     elif [ $ret -gt 127 ]; then
@@ -6,6 +6,7 @@
 #include "hyperv.h"
 #include "bitops.h"
 #include "alloc_page.h"
+#include "percpu.h"
 
 #define MAX_CPUS 64
 
@@ -31,11 +32,11 @@ struct hv_vcpu {
 	atomic_t sint_received;
 };
 
-static struct hv_vcpu hv_vcpus[MAX_CPUS];
+static DEFINE_PER_CPU(struct hv_vcpu, hv_vcpus);
 
 static void sint_isr(isr_regs_t *regs)
 {
-	atomic_inc(&hv_vcpus[smp_id()].sint_received);
+	atomic_inc(&this_cpu_ptr(&hv_vcpus)->sint_received);
 }
 
 static void *hypercall_page;
@@ -97,7 +98,7 @@ static void setup_cpu(void *ctx)
 	irq_enable();
 
 	vcpu = smp_id();
-	hv = &hv_vcpus[vcpu];
+	hv = this_cpu_ptr(&hv_vcpus);
 
 	hv->msg_page = alloc_page();
 	hv->evt_page = alloc_page();
@@ -124,8 +125,7 @@ static void setup_cpu(void *ctx)
 
 static void teardown_cpu(void *ctx)
 {
-	int vcpu = smp_id();
-	struct hv_vcpu *hv = &hv_vcpus[vcpu];
+	struct hv_vcpu *hv = this_cpu_ptr(&hv_vcpus);
 
 	evt_conn_destroy(EVT_SINT, hv->evt_conn);
 	msg_conn_destroy(MSG_SINT, hv->msg_conn);
@@ -142,7 +142,7 @@ static void teardown_cpu(void *ctx)
 static void do_msg(void *ctx)
 {
 	int vcpu = (ulong)ctx;
-	struct hv_vcpu *hv = &hv_vcpus[vcpu];
+	struct hv_vcpu *hv = per_cpu_ptr(&hv_vcpus, vcpu);
 	struct hv_input_post_message *msg = hv->post_msg;
 
 	msg->payload[0]++;
@@ -156,7 +156,7 @@ static void clear_msg(void *ctx)
 {
 	/* should only be done on the current vcpu */
 	int vcpu = smp_id();
-	struct hv_vcpu *hv = &hv_vcpus[vcpu];
+	struct hv_vcpu *hv = per_cpu_ptr(&hv_vcpus, vcpu);
 	struct hv_message *msg = &hv->msg_page->sint_message[MSG_SINT];
 
 	atomic_set(&hv->sint_received, 0);
@@ -168,7 +168,7 @@ static void clear_msg(void *ctx)
 
 static bool msg_ok(int vcpu)
 {
-	struct hv_vcpu *hv = &hv_vcpus[vcpu];
+	struct hv_vcpu *hv = per_cpu_ptr(&hv_vcpus, vcpu);
 	struct hv_input_post_message *post_msg = hv->post_msg;
 	struct hv_message *msg = &hv->msg_page->sint_message[MSG_SINT];
 
@@ -182,7 +182,7 @@ static bool msg_ok(int vcpu)
 
 static bool msg_busy(int vcpu)
 {
-	struct hv_vcpu *hv = &hv_vcpus[vcpu];
+	struct hv_vcpu *hv = per_cpu_ptr(&hv_vcpus, vcpu);
 	struct hv_input_post_message *post_msg = hv->post_msg;
 	struct hv_message *msg = &hv->msg_page->sint_message[MSG_SINT];
 
@@ -197,7 +197,7 @@ static bool msg_busy(int vcpu)
 static void do_evt(void *ctx)
 {
 	int vcpu = (ulong)ctx;
-	struct hv_vcpu *hv = &hv_vcpus[vcpu];
+	struct hv_vcpu *hv = per_cpu_ptr(&hv_vcpus, vcpu);
 
 	atomic_set(&hv->sint_received, 0);
 	hv->hvcall_status = do_hypercall(HVCALL_SIGNAL_EVENT,
@@ -209,7 +209,7 @@ static void clear_evt(void *ctx)
 {
 	/* should only be done on the current vcpu */
 	int vcpu = smp_id();
-	struct hv_vcpu *hv = &hv_vcpus[vcpu];
+	struct hv_vcpu *hv = per_cpu_ptr(&hv_vcpus, vcpu);
 	ulong *flags = hv->evt_page->slot[EVT_SINT].flags;
 
 	atomic_set(&hv->sint_received, 0);
@@ -220,7 +220,7 @@ static void clear_evt(void *ctx)
 
 static bool evt_ok(int vcpu)
 {
-	struct hv_vcpu *hv = &hv_vcpus[vcpu];
+	struct hv_vcpu *hv = per_cpu_ptr(&hv_vcpus, vcpu);
 	ulong *flags = hv->evt_page->slot[EVT_SINT].flags;
 
 	return flags[BIT_WORD(hv->evt_conn)] == BIT_MASK(hv->evt_conn) &&
@@ -230,7 +230,7 @@ static bool evt_ok(int vcpu)
 
 static bool evt_busy(int vcpu)
 {
-	struct hv_vcpu *hv = &hv_vcpus[vcpu];
+	struct hv_vcpu *hv = per_cpu_ptr(&hv_vcpus, vcpu);
 	ulong *flags = hv->evt_page->slot[EVT_SINT].flags;
 
 	return flags[BIT_WORD(hv->evt_conn)] == BIT_MASK(hv->evt_conn) &&
@@ -10,8 +10,7 @@
 #include "hyperv.h"
 #include "asm/barrier.h"
 #include "alloc_page.h"
-
-#define MAX_CPUS 4
+#include "percpu.h"
 
 #define SINT1_VEC 0xF1
 #define SINT2_VEC 0xF2
@@ -20,8 +19,6 @@
 #define SINT2_NUM 3
 #define ONE_MS_IN_100NS 10000
 
-static struct spinlock g_synic_alloc_lock;
-
 struct stimer {
     int sint;
     int index;
@@ -35,24 +32,7 @@ struct svcpu {
     struct stimer timer[HV_SYNIC_STIMER_COUNT];
 };
 
-static struct svcpu g_synic_vcpu[MAX_CPUS];
-
-static void *synic_alloc_page(void)
-{
-    void *page;
-
-    spin_lock(&g_synic_alloc_lock);
-    page = alloc_page();
-    spin_unlock(&g_synic_alloc_lock);
-    return page;
-}
-
-static void synic_free_page(void *page)
-{
-    spin_lock(&g_synic_alloc_lock);
-    free_page(page);
-    spin_unlock(&g_synic_alloc_lock);
-}
+static DEFINE_PER_CPU(struct svcpu, g_synic_vcpu);
 
 static void stimer_init(struct stimer *timer, int index)
 {
@@ -62,12 +42,12 @@ static void stimer_init(struct stimer *timer, int index)
 
 static void synic_enable(void)
 {
+    struct svcpu *svcpu = this_cpu_ptr(&g_synic_vcpu);
     int vcpu = smp_id(), i;
-    struct svcpu *svcpu = &g_synic_vcpu[vcpu];
 
     memset(svcpu, 0, sizeof(*svcpu));
     svcpu->vcpu = vcpu;
-    svcpu->msg_page = synic_alloc_page();
+    svcpu->msg_page = alloc_page();
     for (i = 0; i < ARRAY_SIZE(svcpu->timer); i++) {
         stimer_init(&svcpu->timer[i], i);
     }
@@ -131,7 +111,7 @@ static void process_stimer_msg(struct svcpu *svcpu,
 
 static void __stimer_isr(int vcpu)
 {
-    struct svcpu *svcpu = &g_synic_vcpu[vcpu];
+    struct svcpu *svcpu = per_cpu_ptr(&g_synic_vcpu, vcpu);
     struct hv_message_page *msg_page;
     struct hv_message *msg;
     int i;
@@ -196,8 +176,8 @@ static void stimer_start(struct stimer *timer,
 
 static void stimers_shutdown(void)
 {
-    int vcpu = smp_id(), i;
-    struct svcpu *svcpu = &g_synic_vcpu[vcpu];
+    struct svcpu *svcpu = this_cpu_ptr(&g_synic_vcpu);
+    int i;
 
     for (i = 0; i < ARRAY_SIZE(svcpu->timer); i++) {
         stimer_shutdown(&svcpu->timer[i]);
@@ -206,13 +186,12 @@ static void stimers_shutdown(void)
 
 static void synic_disable(void)
 {
-    int vcpu = smp_id();
-    struct svcpu *svcpu = &g_synic_vcpu[vcpu];
+    struct svcpu *svcpu = this_cpu_ptr(&g_synic_vcpu);
 
     wrmsr(HV_X64_MSR_SCONTROL, 0);
     wrmsr(HV_X64_MSR_SIMP, 0);
     wrmsr(HV_X64_MSR_SIEFP, 0);
-    synic_free_page(svcpu->msg_page);
+    free_page(svcpu->msg_page);
 }
 
 
@@ -274,7 +253,8 @@ static void stimer_test_auto_enable_periodic(int vcpu, struct stimer *timer)
 
 static void stimer_test_one_shot_busy(int vcpu, struct stimer *timer)
 {
-    struct hv_message_page *msg_page = g_synic_vcpu[vcpu].msg_page;
+    struct hv_message_page *msg_page =
+        per_cpu_ptr(&g_synic_vcpu, vcpu)->msg_page;
     struct hv_message *msg = &msg_page->sint_message[timer->sint];
 
     msg->header.message_type = HVMSG_TIMER_EXPIRED;
@@ -304,7 +284,7 @@ static void stimer_test_one_shot_busy(int vcpu, struct stimer *timer)
 static void stimer_test(void *ctx)
 {
     int vcpu = smp_id();
-    struct svcpu *svcpu = &g_synic_vcpu[vcpu];
+    struct svcpu *svcpu = this_cpu_ptr(&g_synic_vcpu);
     struct stimer *timer1, *timer2;
 
     irq_enable();
@@ -338,8 +318,6 @@ static void stimer_test_all(void)
     enable_apic();
 
     ncpus = cpu_count();
-    if (ncpus > MAX_CPUS)
-        report_abort("number cpus exceeds %d", MAX_CPUS);
     printf("cpus = %d\n", ncpus);
 
     handle_irq(SINT1_VEC, stimer_isr);
@@ -0,0 +1,119 @@
+/*
+ * Page allocator throughput on an increasing number of CPUs
+ *
+ * Each CPU repeatedly allocates a batch of pages, which is more than the
+ * per-CPU page cache holds, tags them and frees them again.  The cost of
+ * an alloc_page()/free_page() pair is reported for 1, 2, 4, ... CPUs;
+ * with the per-CPU caches it should stay about flat as CPUs are added.
+ *
+ * The work goes to all CPUs with on_cpus(); the first ones in take part
+ * in a run, the others return right away.  arm64 and s390x build
+ * this file too.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#include "libcflat.h"
+#include "alloc_page.h"
+#include "vmalloc.h"
+#include "bench.h"
+#include <asm/barrier.h>
+#include <asm/smp.h>
+
+#define BATCH		48
+#define ROUNDS		2000
+#define MAX_CPUS	256
+
+static int tickets, started;
+static int nr_running;
+static bool errors;
+static u64 cycles[MAX_CPUS];
+
+static void count_cpu(void *data)
+{
+	__sync_fetch_and_add(&tickets, 1);
+}
+
+static void alloc_free(void *data)
+{
+	unsigned long *pages[BATCH];
+	long ticket;
+	u64 start;
+	int i, j;
+
+	ticket = __sync_fetch_and_add(&tickets, 1);
+	if (ticket >= nr_running)
+		return;
+
+	__sync_fetch_and_add(&started, 1);
+	while (*(volatile int *)&started < nr_running)
+		cpu_relax();
+
+	start = bench_cycles();
+	for (i = 0; i < ROUNDS; i++) {
+		for (j = 0; j < BATCH; j++) {
+			pages[j] = alloc_page();
+			if (!pages[j] || *pages[j]) {
+				errors = true;
+				goto out;
+			}
+			*pages[j] = ticket + 1;
+		}
+		for (j = 0; j < BATCH; j++) {
+			/* somebody else was handed the same page */
+			if (*pages[j] != ticket + 1)
+				errors = true;
+			free_page(pages[j]);
+		}
+	}
+out:
+	cycles[ticket] = bench_cycles() - start;
+}
+
+static void run(int ncpus)
+{
+	char metric[64];
+	u64 sum = 0, ns;
+	int cpu;
+
+	tickets = started = 0;
+	nr_running = ncpus;
+	errors = false;
+	smp_wmb();
+
+	on_cpus(alloc_free, NULL);
+
+	for (cpu = 0; cpu < ncpus; cpu++)
+		sum += cycles[cpu];
+
+	report("alloc/free on %d cpus", !errors, ncpus);
+	snprintf(metric, sizeof(metric), "alloc_free_page.cpus%d", ncpus);
+	ns = bench_cycles_to_ns(sum);
+	if (ns)
+		report_perf(metric, ns / ((u64)ncpus * ROUNDS * BATCH), "ns");
+	else
+		report_perf(metric, sum / ((u64)ncpus * ROUNDS * BATCH),
+			    "cycles");
+}
+
+int main(int ac, char **av)
+{
+	int ncpus, n;
+
+	if (!page_alloc_initialized())
+		setup_vm();
+#if defined(__i386__) || defined(__x86_64__)
+	smp_init();
+#endif
+
+	tickets = 0;
+	on_cpus(count_cpu, NULL);
+	ncpus = MIN(tickets, MAX_CPUS);
+
+	report_prefix_push("page_alloc");
+	for (n = 1; n < ncpus; n *= 2)
+		run(n);
+	run(ncpus);
+	report_prefix_pop();
+
+	return report_summary();
+}
@@ -0,0 +1,139 @@
+/*
+ * parallel_for() and the task queue
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+#include "libcflat.h"
+#include "bench.h"
+#include "parallel.h"
+#include "smp.h"
+#include <asm/barrier.h>
+
+#define NR_ITERS	100003
+#define CHUNK		64
+#define NR_SPAWNS	1000
+#define TREE_DEPTH	12
+#define WORK_ITERS	(1 << 20)
+
+static unsigned char visits[NR_ITERS];
+static unsigned long calls, bad_chunks;
+static unsigned long tasks_done;
+static bool cpu_worked[256];
+
+static void visit(void *data, unsigned long begin, unsigned long end)
+{
+	unsigned long chunk = (unsigned long)data;
+	unsigned long i;
+
+	if (begin >= end || end - begin > chunk)
+		__sync_fetch_and_add(&bad_chunks, 1);
+	for (i = begin; i < end; i++)
+		visits[i]++;
+	__sync_fetch_and_add(&calls, 1);
+	cpu_worked[smp_id() & 255] = true;
+}
+
+static void check_visits(const char *msg, unsigned long begin,
+			 unsigned long end, unsigned long chunk)
+{
+	unsigned long i, wrong = 0;
+
+	memset(visits, 0, sizeof(visits));
+	calls = bad_chunks = 0;
+	parallel_for(begin, end, chunk, visit, (void *)chunk);
+
+	for (i = 0; i < NR_ITERS; i++)
+		wrong += visits[i] != (i >= begin && i < end);
+	report("%s", !wrong && !bad_chunks &&
+	       calls == (end - begin + chunk - 1) / chunk, msg);
+}
+
+static void count_task(void *data, unsigned long begin, unsigned long end)
+{
+	__sync_fetch_and_add(&tasks_done, 1);
+}
+
+static void spawn_many(void *data, unsigned long begin, unsigned long end)
+{
+	int i;
+
+	/* more than a deque holds, so that some run right away */
+	for (i = 0; i < NR_SPAWNS; i++)
+		task_spawn(count_task, NULL, 0, 0);
+	count_task(data, begin, end);
+}
+
+static void spawn_tree(void *data, unsigned long depth, unsigned long end)
+{
+	if (depth < TREE_DEPTH) {
+		task_spawn(spawn_tree, NULL, depth + 1, 0);
+		task_spawn(spawn_tree, NULL, depth + 1, 0);
+	}
+	__sync_fetch_and_add(&tasks_done, 1);
+}
+
+static void work(void *data, unsigned long begin, unsigned long end)
+{
+	unsigned long *sum = data;
+	unsigned long i, s = 0;
+
+	for (i = begin; i < end; i++)
+		s += i * i;
+	__sync_fetch_and_add(sum, s);
+}
+
+static void report_parallel_perf(void)
+{
+	unsigned long sum = 0, expected = 0, i;
+	u64 cycles, ns;
+
+	for (i = 0; i < WORK_ITERS; i++)
+		expected += i * i;
+
+	cycles = bench_cycles();
+	parallel_for(0, WORK_ITERS, 4096, work, &sum);
+	cycles = bench_cycles() - cycles;
+	report("sum", sum == expected);
+
+	ns = bench_cycles_to_ns(cycles);
+	if (ns)
+		report_perf("parallel_for", ns, "ns");
+	else
+		report_perf("parallel_for", cycles, "cycles");
+}
+
+int main(int argc, char **argv)
+{
+	int i, nr = 0;
+
+	smp_init();
+
+	report_prefix_push("parallel_for");
+	check_visits("whole chunks", 0, NR_ITERS / CHUNK * CHUNK, CHUNK);
+	check_visits("partial chunk", 3, NR_ITERS, CHUNK);
+	check_visits("single iteration chunks", 0, 1000, 1);
+	check_visits("one chunk", 10, 20, NR_ITERS);
+	check_visits("empty", 5, 5, CHUNK);
+	report_parallel_perf();
+	report_prefix_pop();
+
+	report_prefix_push("tasks");
+	tasks_done = 0;
+	tasks_run(spawn_many, NULL, 0, 0);
+	report("spawn", tasks_done == NR_SPAWNS + 1);
+
+	tasks_done = 0;
+	tasks_run(spawn_tree, NULL, 0, 0);
+	report("tree", tasks_done == (2ul << TREE_DEPTH) - 1);
+
+	tasks_done = 0;
+	task_spawn(count_task, NULL, 0, 0);
+	report("spawn out of tasks_run", tasks_done == 1);
+	report_prefix_pop();
+
+	for (i = 0; i < ARRAY_SIZE(cpu_worked); i++)
+		nr += cpu_worked[i];
+	printf("%d of %d CPUs took work\n", nr, cpu_count());
+
+	return report_summary();
+}
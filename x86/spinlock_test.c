@@ -0,0 +1,37 @@
+/*
+ * Spinlock throughput and fairness, with the harness arm/spinlock-test.c
+ * uses
+ *
+ * Without arguments, each flavour of spin_lock() is tried in turn;
+ * "tas", "ticket", "mcs" or "spin_lock" try just that one.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+#include "libcflat.h"
+#include "spinlock-test.h"
+#include "smp.h"
+
+#define LOOP_SIZE	1000000
+
+static struct lock_ops lock_ops_list[] = {
+	{ "tas",	tas_spin_lock,		tas_spin_unlock },
+	{ "ticket",	ticket_spin_lock,	ticket_spin_unlock },
+	{ "mcs",	mcs_spin_lock,		mcs_spin_unlock },
+	{ "spin_lock",	spin_lock,		spin_unlock },
+};
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	smp_init();
+
+	for (i = 0; i < ARRAY_SIZE(lock_ops_list); i++) {
+		if (argc > 1 ? !strcmp(argv[1], lock_ops_list[i].name)
+			     : strcmp(lock_ops_list[i].name, "spin_lock"))
+			run_spinlock_test(&lock_ops_list[i], cpu_count(),
+					  LOOP_SIZE);
+	}
+
+	return report_summary();
+}
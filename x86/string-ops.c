@@ -0,0 +1,133 @@
+/*
+ * memset, memcpy and memmove: the arch versions against the generic ones
+ *
+ * The arch versions are first checked against the generic ones for all
+ * small lengths and alignments, including overlapping moves in both
+ * directions.  Then both are timed with the bench harness on a few
+ * buffer sizes, so that the PERF lines show what the arch versions buy.
+ *
+ * arm and s390x build this file too.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2.
+ */
+#include "libcflat.h"
+#include "alloc_page.h"
+#include "vmalloc.h"
+#include "bench.h"
+#include <asm/page.h>
+
+#define BUF_ORDER	4
+#define BUF_SIZE	(PAGE_SIZE << BUF_ORDER)
+#define CHECK_LEN	300
+#define CHECK_SIZE	(CHECK_LEN + 64)
+
+static u8 *src, *dst, *ref;
+
+static void fill(u8 *buf, size_t len, u8 seed)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = seed + i * 7;
+}
+
+static void check_ops(void)
+{
+	bool set_ok = true, cpy_ok = true, move_ok = true;
+	size_t off, len;
+
+	fill(src, CHECK_SIZE, 3);
+	for (off = 0; off < 16; off++) {
+		for (len = 0; len < CHECK_LEN; len++) {
+			fill(dst, CHECK_SIZE, 1);
+			fill(ref, CHECK_SIZE, 1);
+			memset(dst + off, off ? 0xa5 : 0, len);
+			generic_memset(ref + off, off ? 0xa5 : 0, len);
+			if (generic_memcmp(dst, ref, CHECK_SIZE))
+				set_ok = false;
+
+			memcpy(dst + off, src + 15 - off, len);
+			generic_memcpy(ref + off, src + 15 - off, len);
+			if (generic_memcmp(dst, ref, CHECK_SIZE))
+				cpy_ok = false;
+
+			/* dst above src, then below */
+			memmove(dst + off + 16, dst + 16, len);
+			generic_memmove(ref + off + 16, ref + 16, len);
+			memmove(dst + 16, dst + off + 32, len);
+			generic_memmove(ref + 16, ref + off + 32, len);
+			if (generic_memcmp(dst, ref, CHECK_SIZE))
+				move_ok = false;
+		}
+	}
+	report("memset", set_ok);
+	report("memcpy", cpy_ok);
+	report("memmove", move_ok);
+}
+
+#define BENCH_OP(name, call)						\
+static void bench_##name(void *data, u64 iters)			\
+{									\
+	size_t len = *(size_t *)data;					\
+									\
+	while (iters--)							\
+		call;							\
+}
+
+BENCH_OP(memset, memset(dst, 0, len))
+BENCH_OP(generic_memset, generic_memset(dst, 0, len))
+BENCH_OP(memcpy, memcpy(dst, src, len))
+BENCH_OP(generic_memcpy, generic_memcpy(dst, src, len))
+/* overlapping, so that it has to copy backwards */
+BENCH_OP(memmove, memmove(dst + 64, dst, len))
+BENCH_OP(generic_memmove, generic_memmove(dst + 64, dst, len))
+
+static const struct {
+	const char *name;
+	bench_fn fn;
+} bench_ops[] = {
+	{ "memset",		bench_memset },
+	{ "memset_generic",	bench_generic_memset },
+	{ "memcpy",		bench_memcpy },
+	{ "memcpy_generic",	bench_generic_memcpy },
+	{ "memmove",		bench_memmove },
+	{ "memmove_generic",	bench_generic_memmove },
+};
+
+static struct bench b;
+
+static void bench(size_t len)
+{
+	char metric[64];
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(bench_ops); i++) {
+		bench_run(&b, bench_ops[i].fn, &len);
+		snprintf(metric, sizeof(metric), "%s.%lu", bench_ops[i].name,
+			 (unsigned long)len);
+		bench_report(metric, &b);
+	}
+}
+
+int main(int ac, char **av)
+{
+	/* x86 only hands its memory to the page allocator in setup_vm() */
+	if (!page_alloc_initialized())
+		setup_vm();
+
+	/* one more page, for the overlapping moves */
+	src = alloc_pages(BUF_ORDER + 1);
+	dst = alloc_pages(BUF_ORDER + 1);
+	ref = alloc_page();
+	if (!src || !dst || !ref)
+		report_abort("cannot allocate the buffers");
+
+	report_prefix_push("string-ops");
+	check_ops();
+	bench(64);
+	bench(PAGE_SIZE);
+	bench(BUF_SIZE);
+	report_prefix_pop();
+
+	return report_summary();
+}
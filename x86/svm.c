@@ -1,5 +1,7 @@
 #include "svm.h"
 #include "libcflat.h"
+#include "bench.h"
+#include "histogram.h"
 #include "processor.h"
 #include "desc.h"
 #include "msr.h"
@@ -24,21 +26,9 @@ void *scratch_page;
 u64 tsc_start;
 u64 tsc_end;
 
-u64 vmrun_sum, vmexit_sum;
-u64 vmsave_sum, vmload_sum;
-u64 stgi_sum, clgi_sum;
-u64 latvmrun_max;
-u64 latvmrun_min;
-u64 latvmexit_max;
-u64 latvmexit_min;
-u64 latvmload_max;
-u64 latvmload_min;
-u64 latvmsave_max;
-u64 latvmsave_min;
-u64 latstgi_max;
-u64 latstgi_min;
-u64 latclgi_max;
-u64 latclgi_min;
+struct histogram vmrun_hist, vmexit_hist;
+struct bench vmload_bench, vmsave_bench;
+struct bench stgi_bench, clgi_bench;
 u64 runs;
 
 u8 *io_bitmap;
@@ -1177,27 +1167,16 @@ static void latency_prepare(struct test *test)
 {
     default_prepare(test);
     runs = LATENCY_RUNS;
-    latvmrun_min = latvmexit_min = -1ULL;
-    latvmrun_max = latvmexit_max = 0;
-    vmrun_sum = vmexit_sum = 0;
+    hist_reset(&vmrun_hist);
+    hist_reset(&vmexit_hist);
 }
 
 static void latency_test(struct test *test)
 {
-    u64 cycles;
-
 start:
     tsc_end = rdtsc();
 
-    cycles = tsc_end - tsc_start;
-
-    if (cycles > latvmrun_max)
-        latvmrun_max = cycles;
-
-    if (cycles < latvmrun_min)
-        latvmrun_min = cycles;
-
-    vmrun_sum += cycles;
+    hist_record(&vmrun_hist, tsc_end - tsc_start);
 
     tsc_start = rdtsc();
 
@@ -1207,19 +1186,9 @@ start:
 
 static bool latency_finished(struct test *test)
 {
-    u64 cycles;
-
     tsc_end = rdtsc();
 
-    cycles = tsc_end - tsc_start;
-
-    if (cycles > latvmexit_max)
-        latvmexit_max = cycles;
-
-    if (cycles < latvmexit_min)
-        latvmexit_min = cycles;
-
-    vmexit_sum += cycles;
+    hist_record(&vmexit_hist, tsc_end - tsc_start);
 
     test->vmcb->save.rip += 3;
 
@@ -1230,10 +1199,8 @@ static bool latency_finished(struct test *test)
 
 static bool latency_check(struct test *test)
 {
-    printf("    Latency VMRUN : max: %ld min: %ld avg: %ld\n", latvmrun_max,
-            latvmrun_min, vmrun_sum / LATENCY_RUNS);
-    printf("    Latency VMEXIT: max: %ld min: %ld avg: %ld\n", latvmexit_max,
-            latvmexit_min, vmexit_sum / LATENCY_RUNS);
+    hist_report("latency_vmrun", &vmrun_hist, "cycles");
+    hist_report("latency_vmexit", &vmexit_hist, "cycles");
     return true;
 }
 
@@ -1241,52 +1208,32 @@ static void lat_svm_insn_prepare(struct test *test)
 {
     default_prepare(test);
     runs = LATENCY_RUNS;
-    latvmload_min = latvmsave_min = latstgi_min = latclgi_min = -1ULL;
-    latvmload_max = latvmsave_max = latstgi_max = latclgi_max = 0;
-    vmload_sum = vmsave_sum = stgi_sum = clgi_sum;
+    bench_reset(&vmload_bench);
+    bench_reset(&vmsave_bench);
+    bench_reset(&stgi_bench);
+    bench_reset(&clgi_bench);
 }
 
 static bool lat_svm_insn_finished(struct test *test)
 {
     u64 vmcb_phys = virt_to_phys(test->vmcb);
-    u64 cycles;
 
     for ( ; runs != 0; runs--) {
         tsc_start = rdtsc();
         asm volatile("vmload\n\t" : : "a"(vmcb_phys) : "memory");
-        cycles = rdtsc() - tsc_start;
-        if (cycles > latvmload_max)
-            latvmload_max = cycles;
-        if (cycles < latvmload_min)
-            latvmload_min = cycles;
-        vmload_sum += cycles;
+        bench_record(&vmload_bench, rdtsc() - tsc_start);
 
         tsc_start = rdtsc();
         asm volatile("vmsave\n\t" : : "a"(vmcb_phys) : "memory");
-        cycles = rdtsc() - tsc_start;
-        if (cycles > latvmsave_max)
-            latvmsave_max = cycles;
-        if (cycles < latvmsave_min)
-            latvmsave_min = cycles;
-        vmsave_sum += cycles;
+        bench_record(&vmsave_bench, rdtsc() - tsc_start);
 
         tsc_start = rdtsc();
         asm volatile("stgi\n\t");
-        cycles = rdtsc() - tsc_start;
-        if (cycles > latstgi_max)
-            latstgi_max = cycles;
-        if (cycles < latstgi_min)
-            latstgi_min = cycles;
-        stgi_sum += cycles;
+        bench_record(&stgi_bench, rdtsc() - tsc_start);
 
         tsc_start = rdtsc();
         asm volatile("clgi\n\t");
-        cycles = rdtsc() - tsc_start;
-        if (cycles > latclgi_max)
-            latclgi_max = cycles;
-        if (cycles < latclgi_min)
-            latclgi_min = cycles;
-        clgi_sum += cycles;
+        bench_record(&clgi_bench, rdtsc() - tsc_start);
     }
 
     return true;
@@ -1294,14 +1241,10 @@ static bool lat_svm_insn_finished(struct test *test)
 
 static bool lat_svm_insn_check(struct test *test)
 {
-    printf("    Latency VMLOAD: max: %ld min: %ld avg: %ld\n", latvmload_max,
-            latvmload_min, vmload_sum / LATENCY_RUNS);
-    printf("    Latency VMSAVE: max: %ld min: %ld avg: %ld\n", latvmsave_max,
-            latvmsave_min, vmsave_sum / LATENCY_RUNS);
-    printf("    Latency STGI:   max: %ld min: %ld avg: %ld\n", latstgi_max,
-            latstgi_min, stgi_sum / LATENCY_RUNS);
-    printf("    Latency CLGI:   max: %ld min: %ld avg: %ld\n", latclgi_max,
-            latclgi_min, clgi_sum / LATENCY_RUNS);
+    bench_report("latency_vmload", &vmload_bench);
+    bench_report("latency_vmsave", &vmsave_bench);
+    bench_report("latency_stgi", &stgi_bench);
+    bench_report("latency_clgi", &clgi_bench);
     return true;
 }
 
@@ -1,12 +1,9 @@
 /*
- * qemu command line | grep latency | cut -f 2 -d ":" > latency
+ * The latency of the TSC deadline timer interrupt, in TSC cycles, is
+ * recorded by the interrupt handler in a histogram, whose percentiles
+ * are printed as PERF lines at the end.
  *
- * In octave:
- * load latency
- * min(latency)
- * max(latency)
- * mean(latency)
- * hist(latency, 50)
+ * Arguments: [delta [samples [breakmax]]]
  */
 
 /*
@@ -21,6 +18,7 @@
  */
 
 #include "libcflat.h"
+#include "histogram.h"
 #include "apic.h"
 #include "vm.h"
 #include "smp.h"
@@ -42,9 +40,10 @@ static void test_lapic_existence(void)
 static int tdt_count;
 u64 exptime;
 int delta;
-#define TABLE_SIZE 10000
-u64 table[TABLE_SIZE];
-volatile int table_idx;
+#define NR_SAMPLES 10000
+static struct histogram hist;
+volatile int nr_samples;
+u64 last_latency;
 volatile int hitmax = 0;
 int breakmax = 0;
 
@@ -53,8 +52,11 @@ static void tsc_deadline_timer_isr(isr_regs_t *regs)
     u64 now = rdtsc();
     ++tdt_count;
 
-    if (table_idx < TABLE_SIZE && tdt_count > 1)
-        table[table_idx++] = now - exptime;
+    if (tdt_count > 1) {
+        last_latency = now - exptime;
+        hist_record(&hist, last_latency);
+        nr_samples++;
+    }
 
     if (breakmax && tdt_count > 1 && (now - exptime) > breakmax) {
         hitmax = 1;
@@ -102,7 +104,7 @@ static void test_tsc_deadline_timer(void)
 
 int main(int argc, char **argv)
 {
-    int i, size;
+    int size;
 
     setup_vm();
     smp_init();
@@ -112,21 +114,19 @@ int main(int argc, char **argv)
     mask_pic_interrupts();
 
     delta = argc <= 1 ? 200000 : atol(argv[1]);
-    size = argc <= 2 ? TABLE_SIZE : atol(argv[2]);
+    size = argc <= 2 ? NR_SAMPLES : atol(argv[2]);
     breakmax = argc <= 3 ? 0 : atol(argv[3]);
     printf("breakmax=%d\n", breakmax);
     test_tsc_deadline_timer();
     irq_enable();
 
     /* The condition might have triggered already, so check before HLT. */
-    while (!hitmax && table_idx < size)
+    while (!hitmax && nr_samples < size)
         asm volatile("hlt");
 
-    for (i = 0; i < table_idx; i++) {
-        if (hitmax && i == table_idx-1)
-            printf("hit max: %d < ", breakmax);
-        printf("latency: %" PRId64 "\n", table[i]);
-    }
+    if (hitmax)
+        printf("hit max: %d < %" PRId64 "\n", breakmax, last_latency);
+    hist_report("latency", &hist, "cycles");
 
     return report_summary();
 }
@@ -1,4 +1,6 @@
 #include "libcflat.h"
+#include "bench.h"
+#include "histogram.h"
 #include "smp.h"
 #include "processor.h"
 #include "atomic.h"
@@ -19,8 +21,6 @@ struct test {
 	bool (*next)(struct test *);
 };
 
-#define GOAL (1ull << 30)
-
 static int nr_cpus;
 
 static void cpuid_test(void)
@@ -65,22 +65,22 @@ static void nop(void *junk)
 }
 
 volatile int x = 0;
-volatile uint64_t tsc_eoi = 0;
-volatile uint64_t tsc_ipi = 0;
+/* the cost of sending IPIs and of EOIs, recorded as they happen */
+static struct histogram ipi_hist, eoi_hist;
 
 static void self_ipi_isr(isr_regs_t *regs)
 {
 	x++;
 	uint64_t start = rdtsc();
 	eoi();
-	tsc_eoi += rdtsc() - start;
+	hist_record(&eoi_hist, rdtsc() - start);
 }
 
 static void x2apic_self_ipi(int vec)
 {
 	uint64_t start = rdtsc();
 	wrmsr(0x83f, vec);
-	tsc_ipi += rdtsc() - start;
+	hist_record(&ipi_hist, rdtsc() - start);
 }
 
 static void apic_self_ipi(int vec)
@@ -88,7 +88,7 @@ static void apic_self_ipi(int vec)
 	uint64_t start = rdtsc();
         apic_icr_write(APIC_INT_ASSERT | APIC_DEST_SELF | APIC_DEST_PHYSICAL |
 		       APIC_DM_FIXED | IPI_TEST_VECTOR, vec);
-	tsc_ipi += rdtsc() - start;
+	hist_record(&ipi_hist, rdtsc() - start);
 }
 
 static void self_ipi_sti_nop(void)
@@ -190,7 +190,7 @@ static void ipi(void)
 {
 	uint64_t start = rdtsc();
 	on_cpu(1, nop, 0);
-	tsc_ipi += rdtsc() - start;
+	hist_record(&ipi_hist, rdtsc() - start);
 }
 
 static void ipi_halt(void)
@@ -498,24 +498,35 @@ static struct test tests[] = {
 	{ NULL, "pci-io", .parallel = 0, .next = pci_io_next },
 };
 
-unsigned iterations;
+static u64 iterations;
 
 static void run_test(void *_func)
 {
-    int i;
+    u64 i;
     void (*func)(void) = _func;
 
     for (i = 0; i < iterations; ++i)
         func();
 }
 
-static bool do_test(struct test *test)
+static void run_batch(void *data, u64 iters)
 {
-	int i;
-	unsigned long long t1, t2;
-        void (*func)(void);
+	struct test *test = data;
+	u64 i;
 
-        iterations = 32;
+	iterations = iters;
+	if (!test->parallel) {
+		for (i = 0; i < iterations; ++i)
+			test->func();
+	} else {
+		on_cpus(run_test, test->func);
+	}
+}
+
+static bool do_test(struct test *test)
+{
+	static struct bench bench;
+	char metric[64];
 
         if (test->valid && !test->valid()) {
 		printf("%s (skipped)\n", test->name);
@@ -526,30 +537,19 @@ static bool do_test(struct test *test)
 		return false;
 	}
 
-	func = test->func;
-        if (!func) {
+        if (!test->func) {
 		printf("%s (skipped)\n", test->name);
 		return false;
 	}
 
-	do {
-		tsc_eoi = tsc_ipi = 0;
-		iterations *= 2;
-		t1 = rdtsc();
-
-		if (!test->parallel) {
-			for (i = 0; i < iterations; ++i)
-				func();
-		} else {
-			on_cpus(run_test, func);
-		}
-		t2 = rdtsc();
-	} while ((t2 - t1) < GOAL);
-	printf("%s %d\n", test->name, (int)((t2 - t1) / iterations));
-	if (tsc_ipi)
-		printf("  ipi %s %d\n", test->name, (int)(tsc_ipi / iterations));
-	if (tsc_eoi)
-		printf("  eoi %s %d\n", test->name, (int)(tsc_eoi / iterations));
+	hist_reset(&ipi_hist);
+	hist_reset(&eoi_hist);
+	bench_run(&bench, run_batch, test);
+	bench_report(test->name, &bench);
+	snprintf(metric, sizeof(metric), "%s.ipi", test->name);
+	hist_report(metric, &ipi_hist, "cycles");
+	snprintf(metric, sizeof(metric), "%s.eoi", test->name);
+	hist_report(metric, &eoi_hist, "cycles");
 
 	return test->next;
 }